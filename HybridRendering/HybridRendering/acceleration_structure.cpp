@@ -0,0 +1,475 @@
+#include <array>
+#include <chrono>
+#include <map>
+#include <string>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "acceleration_structure.h"
+
+namespace {
+    // Shifts a (index << 3) | count reference by the offset of whatever it points to
+    uint32_t offsetReference(uint32_t reference, uint32_t nodeOffset, uint32_t primitiveOffset) {
+        const uint32_t count{ reference & BVH::COUNT_MASK };
+        const uint32_t index{ reference >> BVH::COUNT_BITS };
+        const uint32_t offset{ count == 0 ? nodeOffset : primitiveOffset };
+        return ((index + offset) << BVH::COUNT_BITS) | count;
+    }
+
+    // Nodes coming out of BVH::buildSAH() index from 0, but all of the BLASes share
+    // one node buffer and one triangle buffer on the GPU, so we have to shift them.
+    void offsetNodes(std::vector<BVHNodeGPU>& nodes, uint32_t nodeOffset, uint32_t primitiveOffset) {
+        for (BVHNodeGPU& node : nodes) {
+            if (node.skipIndex != BVH::INVALID_INDEX)
+                node.skipIndex += nodeOffset;
+
+            node.primitiveInfo = offsetReference(node.primitiveInfo, nodeOffset, primitiveOffset);
+        }
+    }
+
+    // Collapses a mesh's binary BLAS, appends it to the shared wide node array and returns its root.
+    // Returns BVH::INVALID_INDEX and appends nothing if ray_trace.comp's stack is too small for it.
+    template <uint32_t WIDTH>
+    uint32_t appendWideBLAS(const std::vector<BVHNodeGPU>& nodes, uint32_t firstTriangle, std::vector<WideBVHNodeGPU<WIDTH>>& wideNodes) {
+        uint32_t stackSize{ 0 };
+        std::vector<WideBVHNodeGPU<WIDTH>> meshNodes{ BVH::collapse<WIDTH>(nodes, stackSize) };
+
+        if (stackSize > BVH::WIDE_STACK_SIZE) {
+            PLOGW << "The BVH" << WIDTH << " BLAS needs " << stackSize << " stack entries but ray_trace.comp only has " << BVH::WIDE_STACK_SIZE
+                << ", keeping the binary one";
+            return BVH::INVALID_INDEX;
+        }
+
+        const uint32_t root{ static_cast<uint32_t>(wideNodes.size()) };
+        for (WideBVHNodeGPU<WIDTH>& node : meshNodes) {
+            for (uint32_t& child : node.children) {
+                if (child != BVH::INVALID_INDEX)
+                    child = offsetReference(child, root, firstTriangle);
+            }
+        }
+        wideNodes.insert(wideNodes.end(), meshNodes.begin(), meshNodes.end());
+
+        PLOGD << "Collapsed into " << meshNodes.size() << " BVH" << WIDTH << " nodes (" << meshNodes.size() * sizeof(WideBVHNodeGPU<WIDTH>)
+            << " bytes, binary was " << nodes.size() * sizeof(BVHNodeGPU) << " bytes), traversal needs " << stackSize << " stack entries";
+
+        return root;
+    }
+
+    void uploadBuffer(unsigned int& ssbo, const void* data, size_t size, GLenum usage) {
+        if (ssbo == 0)
+            glGenBuffers(1, &ssbo);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+}
+
+AccelerationStructure::AccelerationStructure(BVH::BuildMode buildMode, BVH::NodeLayout blasLayout, TriangleLayout triangleLayout)
+    : buildMode{ buildMode }
+    , blasLayout{ blasLayout }
+    , triangleLayout{ triangleLayout }
+{
+}
+
+uint32_t AccelerationStructure::addMesh(std::vector<TriangleGPU> meshTriangles, bool convex) {
+    const auto buildStart{ std::chrono::steady_clock::now() };
+
+    Mesh mesh{};
+    mesh.firstTriangle = static_cast<uint32_t>(triangleShading.size());
+    mesh.triangleCount = static_cast<uint32_t>(meshTriangles.size());
+    mesh.firstVertex = static_cast<uint32_t>(vertices.size());
+    mesh.blasRoot = static_cast<uint32_t>(blasNodes.size());
+    mesh.dynamic = false;
+    mesh.wide = false;
+    mesh.convex = convex;
+
+    for (const TriangleGPU& triangle : meshTriangles)
+        mesh.bounds.grow(BVH::triangleBounds(triangle));
+
+    // The BLAS is built over the quantized triangles, so its boxes contain them after snapping
+    setGrid(mesh);
+    if (triangleLayout == TriangleLayout::quantized) {
+        for (TriangleGPU& triangle : meshTriangles)
+            triangle = quantizeToGrid(triangle, mesh.gridOrigin, mesh.gridScale);
+    }
+
+    // NOTE: this reorders meshTriangles so that every leaf points to a contiguous range
+    std::vector<BVHNodeGPU> nodes{ BVH::build(buildMode, meshTriangles) };
+
+    const std::chrono::duration<double, std::milli> buildTime{ std::chrono::steady_clock::now() - buildStart };
+
+    // Before offsetNodes(), sahCost() expects the root at index 0
+    PLOGD << "Built " << BVH::buildModeName(buildMode) << " BLAS for mesh " << meshes.size() << " (" << mesh.triangleCount << " triangles, "
+        << nodes.size() << " nodes) in " << buildTime.count() << " ms, SAH cost " << BVH::sahCost(nodes);
+
+    // A mesh too deep for the shader's stack stays binary, skipping pushes would miss occluders
+    uint32_t wideRoot{ BVH::INVALID_INDEX };
+    if (blasLayout == BVH::NodeLayout::bvh4)
+        wideRoot = appendWideBLAS(nodes, mesh.firstTriangle, wide4BLASNodes);
+    else if (blasLayout == BVH::NodeLayout::bvh8)
+        wideRoot = appendWideBLAS(nodes, mesh.firstTriangle, wide8BLASNodes);
+
+    if (wideRoot != BVH::INVALID_INDEX) {
+        mesh.blasRoot = wideRoot;
+        mesh.wide = true;
+    }
+    else {
+        offsetNodes(nodes, mesh.blasRoot, mesh.firstTriangle);
+        blasNodes.insert(blasNodes.end(), nodes.begin(), nodes.end());
+    }
+
+    for (const TriangleGPU& triangle : meshTriangles)
+        triangleShading.emplace_back(triangle);
+
+    if (triangleLayout == TriangleLayout::indexed)
+        appendIndexedTriangles(meshTriangles);
+    else if (triangleLayout == TriangleLayout::quantized) {
+        for (const TriangleGPU& triangle : meshTriangles)
+            quantizedTriangles.emplace_back(triangle);
+    }
+    else {
+        for (const TriangleGPU& triangle : meshTriangles)
+            triangleEdges.emplace_back(triangle);
+    }
+
+    meshes.push_back(mesh);
+
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t AccelerationStructure::addDynamicMesh(uint32_t maxTriangles, const BVH::AABB& bounds, bool convex) {
+    if (!gpuBuilder)
+        gpuBuilder = std::make_unique<GPUBVHBuilder>(triangleLayout);
+
+    Mesh mesh{};
+    mesh.firstTriangle = static_cast<uint32_t>(triangleShading.size());
+    mesh.triangleCount = maxTriangles;
+    mesh.firstVertex = static_cast<uint32_t>(vertices.size());
+    mesh.blasRoot = static_cast<uint32_t>(blasNodes.size());
+    mesh.bounds = bounds;
+    mesh.dynamic = true;
+    mesh.convex = convex;
+    setGrid(mesh);
+
+    // The GPU builder only produces binary nodes, whatever the layout of the other meshes
+    mesh.wide = false;
+
+    // Placeholders until the first rebuild. The root has an inverted box, so rays never enter it.
+    const TriangleGPU emptyTriangle{ glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, 0 };
+    const BVH::AABB empty{};
+    triangleShading.insert(triangleShading.end(), maxTriangles, TriangleShadingGPU{ emptyTriangle });
+
+    // The GPU builder can't share vertices, so with the indexed layout every triangle gets
+    // three of its own that the indices point to once and for all
+    if (triangleLayout == TriangleLayout::indexed) {
+        vertices.insert(vertices.end(), 3 * size_t{ maxTriangles }, glm::vec4{ 0.0f });
+        for (uint32_t i{ 0 }; i < 3 * maxTriangles; ++i)
+            triangleIndices.push_back(mesh.firstVertex + i);
+    }
+    else if (triangleLayout == TriangleLayout::quantized)
+        quantizedTriangles.insert(quantizedTriangles.end(), maxTriangles, TriangleQuantizedGPU{ emptyTriangle });
+    else
+        triangleEdges.insert(triangleEdges.end(), maxTriangles, TriangleEdgesGPU{ emptyTriangle });
+    blasNodes.insert(blasNodes.end(), GPUBVHBuilder::nodeCount(maxTriangles), BVHNodeGPU{ empty.min, empty.max, BVH::INVALID_INDEX, 1u });
+    meshes.push_back(mesh);
+
+    PLOGD << "Added dynamic mesh " << meshes.size() - 1 << " with room for " << maxTriangles << " triangles";
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t AccelerationStructure::addInstance(uint32_t meshIndex, const glm::mat4& objectToWorld, uint32_t objectID) {
+    instances.push_back(Instance{ meshIndex, objectToWorld, objectID });
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void AccelerationStructure::setInstanceTransform(uint32_t instanceIndex, const glm::mat4& objectToWorld) {
+    if (instances[instanceIndex].objectToWorld == objectToWorld)
+        return;
+
+    instances[instanceIndex].objectToWorld = objectToWorld;
+    dirtyInstances.push_back(instanceIndex);
+}
+
+void AccelerationStructure::setInstanceMesh(uint32_t instanceIndex, uint32_t meshIndex) {
+    if (instances[instanceIndex].meshIndex == meshIndex)
+        return;
+
+    instances[instanceIndex].meshIndex = meshIndex;
+    dirtyInstances.push_back(instanceIndex);
+}
+
+void AccelerationStructure::rebuildDynamicMesh(uint32_t meshIndex, unsigned int sourceSSBO, uint32_t triangleCount) {
+    const Mesh& mesh{ meshes[meshIndex] };
+    if (!mesh.dynamic || triangleCount > mesh.triangleCount) {
+        PLOGE << "Can't rebuild mesh " << meshIndex << " with " << triangleCount << " triangles, it isn't dynamic or doesn't have room";
+        return;
+    }
+
+    gpuBuilder->build(sourceSSBO, triangleCount, buildTarget(mesh));
+}
+
+bool AccelerationStructure::validateDynamicMesh(uint32_t meshIndex, unsigned int sourceSSBO, uint32_t triangleCount) const {
+    return gpuBuilder->validate(sourceSSBO, triangleCount, buildTarget(meshes[meshIndex]));
+}
+
+void AccelerationStructure::update() {
+    if (dirtyInstances.empty())
+        return;
+
+    for (uint32_t instanceIndex : dirtyInstances) {
+        const Instance& instance{ instances[instanceIndex] };
+        InstanceGPU& gpuInstance{ gpuInstances[instanceSlots[instanceIndex]] };
+        gpuInstance.worldToObject = objectToGrid(meshes[instance.meshIndex]) * glm::inverse(instance.objectToWorld);
+        gpuInstance.blasRoot = meshes[instance.meshIndex].blasRoot;
+        gpuInstance.flags = instanceFlags(meshes[instance.meshIndex]);
+    }
+
+    refitTLAS();
+
+    const float refitCost{ BVH::sahCost(tlasNodes) };
+    if (refitCost > builtTLASCost * REBUILD_COST_RATIO || refitsSinceBuild >= MAX_REFITS_BEFORE_REBUILD) {
+        PLOGD << "Rebuilding TLAS after " << refitsSinceBuild << " refits (SAH cost " << refitCost << ", was " << builtTLASCost << " when built)";
+
+        // A rebuild reorders the instances, so everything gets sent over again
+        buildTLAS();
+        uploadBuffer(instanceSSBO, gpuInstances.data(), gpuInstances.size() * sizeof(InstanceGPU), GL_DYNAMIC_DRAW);
+        uploadBuffer(tlasSSBO, tlasNodes.data(), tlasNodes.size() * sizeof(BVHNodeGPU), GL_DYNAMIC_DRAW);
+    }
+    else {
+        // Otherwise only the moved instances and the TLAS nodes have changed
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+        for (uint32_t instanceIndex : dirtyInstances) {
+            const uint32_t slot{ instanceSlots[instanceIndex] };
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, slot * sizeof(InstanceGPU), sizeof(InstanceGPU), &gpuInstances[slot]);
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tlasSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tlasNodes.size() * sizeof(BVHNodeGPU), tlasNodes.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    dirtyInstances.clear();
+}
+
+void AccelerationStructure::build() {
+    buildTLAS();
+    upload();
+    dirtyInstances.clear();
+
+    // Compare against baking every instance into world space like we used to
+    const size_t bytes{ triangleBytes() + triangleShading.size() * sizeof(TriangleShadingGPU) + blasNodes.size() * sizeof(BVHNodeGPU) +
+        wide4BLASNodes.size() * sizeof(WideBVHNodeGPU<4>) + wide8BLASNodes.size() * sizeof(WideBVHNodeGPU<8>) +
+        gpuInstances.size() * sizeof(InstanceGPU) + tlasNodes.size() * sizeof(BVHNodeGPU) };
+    const size_t flattenedBytes{ instancedTriangleCount() * (sizeof(TriangleGPU) + 2 * sizeof(BVHNodeGPU)) };
+    PLOGD << "Acceleration structure: " << meshes.size() << " meshes, " << instances.size() << " instances, "
+        << triangleShading.size() << " unique / " << instancedTriangleCount() << " instanced triangles, "
+        << bytes << " bytes (~" << flattenedBytes << " bytes if flattened)";
+
+    const size_t edgeBytes{ triangleShading.size() * sizeof(TriangleEdgesGPU) };
+    if (triangleLayout == TriangleLayout::indexed) {
+        PLOGD << "Indexed triangles: " << vertices.size() << " vertices, " << triangleBytes() << " bytes instead of "
+            << edgeBytes << " as edges, saving " << static_cast<long long>(edgeBytes) - static_cast<long long>(triangleBytes()) << " bytes";
+    }
+    else if (triangleLayout == TriangleLayout::quantized) {
+        PLOGD << "Quantized triangles: " << triangleBytes() << " bytes instead of " << edgeBytes << " as edges, saving "
+            << edgeBytes - triangleBytes() << " bytes";
+    }
+}
+
+void AccelerationStructure::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, triangleSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, blasSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, instanceSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, tlasSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, wideBLASSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, triangleShadingSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, triangleIndexSSBO);
+}
+
+std::string AccelerationStructure::shaderDefines() const {
+    std::string defines{ triangleLayoutDefines(triangleLayout) };
+    switch (blasLayout) {
+    case BVH::NodeLayout::bvh4:
+        return defines + "#define BVH_WIDTH 4\n#define BVH_STACK_SIZE " + std::to_string(BVH::WIDE_STACK_SIZE) + "\n";
+    case BVH::NodeLayout::bvh8:
+        return defines + "#define BVH_WIDTH 8\n#define BVH_STACK_SIZE " + std::to_string(BVH::WIDE_STACK_SIZE) + "\n";
+    default:
+        return defines;
+    }
+}
+
+size_t AccelerationStructure::wideNodeSize() const {
+    switch (blasLayout) {
+    case BVH::NodeLayout::bvh4:
+        return sizeof(WideBVHNodeGPU<4>);
+    case BVH::NodeLayout::bvh8:
+        return sizeof(WideBVHNodeGPU<8>);
+    default:
+        return 0;
+    }
+}
+
+size_t AccelerationStructure::triangleTestSize() const {
+    switch (triangleLayout) {
+    case TriangleLayout::indexed:
+        return 3 * (sizeof(uint32_t) + sizeof(glm::vec4));
+    case TriangleLayout::quantized:
+        return sizeof(TriangleQuantizedGPU);
+    default:
+        return sizeof(TriangleEdgesGPU);
+    }
+}
+
+size_t AccelerationStructure::instancedTriangleCount() const {
+    size_t count{ 0 };
+    for (const Instance& instance : instances)
+        count += meshes[instance.meshIndex].triangleCount;
+    return count;
+}
+
+void AccelerationStructure::appendIndexedTriangles(const std::vector<TriangleGPU>& meshTriangles) {
+    // Vertices are only shared within a mesh, and only if their positions are exactly the same.
+    // That's all the ray tracer cares about, normals and texture coordinates don't matter here.
+    std::map<std::array<float, 3>, uint32_t> vertexIndices{};
+    const uint32_t firstVertex{ static_cast<uint32_t>(vertices.size()) };
+
+    for (const TriangleGPU& triangle : meshTriangles) {
+        for (const glm::vec4& vertex : { triangle.v0, triangle.v1, triangle.v2 }) {
+            const auto [it, inserted] { vertexIndices.try_emplace({ vertex.x, vertex.y, vertex.z }, static_cast<uint32_t>(vertices.size())) };
+            if (inserted)
+                vertices.emplace_back(vertex.x, vertex.y, vertex.z, 1.0f);
+            triangleIndices.push_back(it->second);
+        }
+    }
+
+    const size_t indexedBytes{ (vertices.size() - firstVertex) * sizeof(glm::vec4) + 3 * meshTriangles.size() * sizeof(uint32_t) };
+    PLOGD << "Indexed " << meshTriangles.size() << " triangles with " << vertices.size() - firstVertex << " unique vertices, "
+        << indexedBytes << " bytes instead of " << meshTriangles.size() * sizeof(TriangleEdgesGPU) << " as edges";
+}
+
+size_t AccelerationStructure::triangleBytes() const {
+    return triangleEdges.size() * sizeof(TriangleEdgesGPU) + vertices.size() * sizeof(glm::vec4) + triangleIndices.size() * sizeof(uint32_t) +
+        quantizedTriangles.size() * sizeof(TriangleQuantizedGPU);
+}
+
+void AccelerationStructure::setGrid(Mesh& mesh) const {
+    mesh.gridOrigin = glm::vec3{ 0.0f };
+    mesh.gridScale = glm::vec3{ 1.0f };
+    if (triangleLayout != TriangleLayout::quantized)
+        return;
+
+    // One cell of headroom, so that rounding a vertex on the max side up never has to be clamped.
+    // The bounds get that cell too, since the TLAS has to contain the snapped triangles.
+    mesh.gridOrigin = mesh.bounds.min;
+    const glm::vec3 extent{ mesh.bounds.max - mesh.bounds.min };
+    for (int axis{ 0 }; axis < 3; ++axis) {
+        if (extent[axis] > 0.0f) {
+            mesh.gridScale[axis] = static_cast<float>(QUANTIZED_POSITION_MAX - 1) / extent[axis];
+            mesh.bounds.max[axis] += 1.0f / mesh.gridScale[axis];
+        }
+    }
+
+    PLOGD << "Quantizing mesh " << meshes.size() << " to cells of " << 1.0f / mesh.gridScale.x << " x " << 1.0f / mesh.gridScale.y
+        << " x " << 1.0f / mesh.gridScale.z << " object space units";
+}
+
+glm::mat4 AccelerationStructure::objectToGrid(const Mesh& mesh) {
+    glm::mat4 transform{ 1.0f };
+    for (int axis{ 0 }; axis < 3; ++axis) {
+        transform[axis][axis] = mesh.gridScale[axis];
+        transform[3][axis] = -mesh.gridOrigin[axis] * mesh.gridScale[axis];
+    }
+    return transform;
+}
+
+GPUBVHBuilder::Target AccelerationStructure::buildTarget(const Mesh& mesh) const {
+    return GPUBVHBuilder::Target{ triangleSSBO, triangleShadingSSBO, mesh.firstTriangle, mesh.firstVertex, blasSSBO, mesh.blasRoot, mesh.gridOrigin, mesh.gridScale };
+}
+
+uint32_t AccelerationStructure::instanceFlags(const Mesh& mesh) {
+    return (mesh.wide ? INSTANCE_WIDE_BLAS : 0) | (mesh.convex ? INSTANCE_CONVEX : 0);
+}
+
+BVH::AABB AccelerationStructure::worldBounds(const Instance& instance) const {
+    const BVH::AABB& objectBounds{ meshes[instance.meshIndex].bounds };
+
+    // Transforming all 8 corners of the object space box gives us a (conservative) world space box
+    BVH::AABB bounds{};
+    for (int corner{ 0 }; corner < 8; ++corner) {
+        const glm::vec4 point{
+            (corner & 1) ? objectBounds.max.x : objectBounds.min.x,
+            (corner & 2) ? objectBounds.max.y : objectBounds.min.y,
+            (corner & 4) ? objectBounds.max.z : objectBounds.min.z,
+            1.0f
+        };
+        bounds.grow(glm::vec3{ instance.objectToWorld * point });
+    }
+
+    return bounds;
+}
+
+void AccelerationStructure::buildTLAS() {
+    std::vector<BVH::AABB> instanceBounds{};
+    instanceBounds.reserve(instances.size());
+    for (const Instance& instance : instances)
+        instanceBounds.push_back(worldBounds(instance));
+
+    const auto buildStart{ std::chrono::steady_clock::now() };
+
+    std::vector<uint32_t> instanceOrder{};
+    tlasNodes = BVH::build(buildMode, instanceBounds, instanceOrder);
+
+    // The TLAS leaves index into gpuInstances, so it has to follow the same order
+    gpuInstances.clear();
+    gpuInstances.reserve(instances.size());
+    instanceSlots.resize(instances.size());
+    for (uint32_t index : instanceOrder) {
+        const Instance& instance{ instances[index] };
+        instanceSlots[index] = static_cast<uint32_t>(gpuInstances.size());
+        const Mesh& mesh{ meshes[instance.meshIndex] };
+        gpuInstances.emplace_back(objectToGrid(mesh) * glm::inverse(instance.objectToWorld), mesh.blasRoot, instance.objectID, instanceFlags(mesh));
+    }
+
+    builtTLASCost = BVH::sahCost(tlasNodes);
+    refitsSinceBuild = 0;
+
+    const std::chrono::duration<double, std::milli> buildTime{ std::chrono::steady_clock::now() - buildStart };
+    PLOGD << "Built " << BVH::buildModeName(buildMode) << " TLAS (" << instances.size() << " instances, " << tlasNodes.size()
+        << " nodes) in " << buildTime.count() << " ms, SAH cost " << builtTLASCost;
+}
+
+void AccelerationStructure::refitTLAS() {
+    if (tlasNodes.empty())
+        return;
+
+    // The TLAS leaves index instances by their slot, so the bounds have to be in that order too
+    std::vector<BVH::AABB> instanceBounds(instances.size());
+    for (uint32_t i{ 0 }; i < instances.size(); ++i)
+        instanceBounds[instanceSlots[i]] = worldBounds(instances[i]);
+
+    BVH::refit(tlasNodes, 0, instanceBounds);
+    ++refitsSinceBuild;
+}
+
+void AccelerationStructure::upload() {
+    if (triangleLayout == TriangleLayout::indexed) {
+        uploadBuffer(triangleSSBO, vertices.data(), vertices.size() * sizeof(glm::vec4), GL_STATIC_DRAW);
+        uploadBuffer(triangleIndexSSBO, triangleIndices.data(), triangleIndices.size() * sizeof(uint32_t), GL_STATIC_DRAW);
+    }
+    else if (triangleLayout == TriangleLayout::quantized)
+        uploadBuffer(triangleSSBO, quantizedTriangles.data(), quantizedTriangles.size() * sizeof(TriangleQuantizedGPU), GL_STATIC_DRAW);
+    else
+        uploadBuffer(triangleSSBO, triangleEdges.data(), triangleEdges.size() * sizeof(TriangleEdgesGPU), GL_STATIC_DRAW);
+    uploadBuffer(triangleShadingSSBO, triangleShading.data(), triangleShading.size() * sizeof(TriangleShadingGPU), GL_STATIC_DRAW);
+    uploadBuffer(blasSSBO, blasNodes.data(), blasNodes.size() * sizeof(BVHNodeGPU), GL_STATIC_DRAW);
+    if (blasLayout == BVH::NodeLayout::bvh4)
+        uploadBuffer(wideBLASSSBO, wide4BLASNodes.data(), wide4BLASNodes.size() * sizeof(WideBVHNodeGPU<4>), GL_STATIC_DRAW);
+    else if (blasLayout == BVH::NodeLayout::bvh8)
+        uploadBuffer(wideBLASSSBO, wide8BLASNodes.data(), wide8BLASNodes.size() * sizeof(WideBVHNodeGPU<8>), GL_STATIC_DRAW);
+
+    // Instances and TLAS nodes change whenever something moves, see update()
+    uploadBuffer(instanceSSBO, gpuInstances.data(), gpuInstances.size() * sizeof(InstanceGPU), GL_DYNAMIC_DRAW);
+    uploadBuffer(tlasSSBO, tlasNodes.data(), tlasNodes.size() * sizeof(BVHNodeGPU), GL_DYNAMIC_DRAW);
+}
@@ -0,0 +1,207 @@
+#ifndef ACCELERATION_STRUCTURE_H
+#define ACCELERATION_STRUCTURE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "bvh_node_gpu.h"
+#include "gpu_bvh_builder.h"
+#include "instance_gpu.h"
+#include "triangle_gpu.h"
+#include "wide_bvh_node_gpu.h"
+
+/*
+	Two-level acceleration structure for the ray traced shadows.
+
+	Every unique mesh is stored once, in object space, with its own bottom-level BVH (BLAS).
+	Objects in the scene are instances of those meshes, and a top-level BVH (TLAS) is built
+	over the world-space bounds of the instances. This way nine crates only cost us the
+	triangles of a single crate. Meshes are either built once on the CPU, or are dynamic
+	and get rebuilt on the GPU from an SSBO whenever their triangles change.
+
+	BLASes are stored either as binary nodes or, to save bandwidth, collapsed into wide nodes
+	with quantized child boxes. Which one an instance uses is in its flags, as is whether its
+	mesh is convex.
+
+	Triangles are split in two: the vertex data the intersection test needs, and everything
+	else, which is only read once a ray has hit something. Both use the same indexing. The
+	vertex data is either a TriangleEdgesGPU per triangle, or shared vertices plus indices
+	when memory matters more than fetches, see TriangleLayout.
+
+	The quantized layout snaps every mesh to a 16-bit grid over its own bounds. The BLAS
+	is built over the grid coordinates too, and the instances take rays straight from
+	world space into grid space, so the ray tracer never has to decode anything.
+
+	SSBO bindings used by ray_trace.comp:
+		3 ==> triangle edges of every mesh, their vertices for the indexed layout, or the quantized triangles
+		4 ==> binary BLAS nodes
+		5 ==> instances
+		6 ==> TLAS nodes
+		7 ==> wide BLAS nodes
+		9 ==> triangle normals and ids
+		10 ==> three vertex indices per triangle, indexed layout only
+*/
+class AccelerationStructure {
+public:
+	// The build mode picks between a fast build (LBVH) and a better tree (SAH) for both levels.
+	// The BLAS layout applies to meshes added with addMesh(), except those too deep for the
+	// wide traversal's stack, which stay binary. The TLAS is always binary.
+	// The triangle layout applies to every mesh.
+	explicit AccelerationStructure(
+		BVH::BuildMode buildMode = BVH::BuildMode::sah,
+		BVH::NodeLayout blasLayout = BVH::NodeLayout::binary,
+		TriangleLayout triangleLayout = TriangleLayout::edges
+	);
+
+	// Adds a mesh given in object space, builds its BLAS and returns the mesh index.
+	// Shadow rays skip a convex mesh's instance when they leave its surface.
+	uint32_t addMesh(std::vector<TriangleGPU> triangles, bool convex = false);
+
+	/*
+		Adds a mesh whose triangles live in an SSBO and may change every frame. Room is reserved
+		for up to maxTriangles, and its BLAS is built on the GPU by rebuildDynamicMesh().
+		bounds has to contain every triangle the mesh will ever have, in object space, since
+		the TLAS never reads anything back from the GPU.
+	*/
+	uint32_t addDynamicMesh(uint32_t maxTriangles, const BVH::AABB& bounds, bool convex = false);
+
+	// Places a mesh in the scene and returns the instance index
+	uint32_t addInstance(uint32_t meshIndex, const glm::mat4& objectToWorld, uint32_t objectID);
+
+	// Builds the TLAS over the current instances and uploads everything to the GPU
+	void build();
+
+	// Moves an instance. Nothing is sent to the GPU until the next update().
+	void setInstanceTransform(uint32_t instanceIndex, const glm::mat4& objectToWorld);
+
+	// Makes an instance use a different mesh, also applied by the next update()
+	void setInstanceMesh(uint32_t instanceIndex, uint32_t meshIndex);
+
+	// Rebuilds the BLAS of a dynamic mesh on the GPU from the first triangleCount triangles
+	// in sourceSSBO, without a CPU round trip. Has to be called after build().
+	void rebuildDynamicMesh(uint32_t meshIndex, unsigned int sourceSSBO, uint32_t triangleCount);
+
+	// Checks the last rebuildDynamicMesh() against the CPU builder, see GPUBVHBuilder::validate()
+	bool validateDynamicMesh(uint32_t meshIndex, unsigned int sourceSSBO, uint32_t triangleCount) const;
+
+	/*
+		Applies the transforms and meshes changed since the last update. Meshes never have to be
+		re-transformed since they live in object space, so moving an object only touches
+		its instance and the TLAS bounds, which are refit bottom-up. If refitting has made
+		the TLAS noticeably worse than a fresh build, it is rebuilt instead.
+	*/
+	void update();
+
+	// Binds the SSBOs to the bindings listed above
+	void bind() const;
+
+	// Defines ray_trace.comp has to be compiled with to read this BLAS and triangle layout
+	std::string shaderDefines() const;
+
+	// Size of a wide BLAS node in bytes, 0 for the binary layout
+	size_t wideNodeSize() const;
+
+	// Bytes a single triangle test reads
+	size_t triangleTestSize() const;
+
+	// World space box around an instance, with its current transform
+	BVH::AABB instanceBounds(uint32_t instanceIndex) const { return worldBounds(instances[instanceIndex]); }
+
+	size_t triangleCount() const { return triangleShading.size(); }
+	size_t instanceCount() const { return instances.size(); }
+	size_t instancedTriangleCount() const;
+
+private:
+	struct Mesh {
+		uint32_t firstTriangle;
+		uint32_t triangleCount; // the capacity for dynamic meshes
+		uint32_t firstVertex; // indexed layout only
+		uint32_t blasRoot;
+		BVH::AABB bounds;
+		glm::vec3 gridOrigin; // grid = (object - gridOrigin) * gridScale, the identity unless quantized
+		glm::vec3 gridScale;
+		bool dynamic;
+		bool wide; // blasRoot indexes the wide nodes
+		bool convex;
+	};
+
+	struct Instance {
+		uint32_t meshIndex;
+		glm::mat4 objectToWorld;
+		uint32_t objectID;
+	};
+
+	// Shares the vertices of a mesh's (already sorted) triangles and appends them with their indices
+	void appendIndexedTriangles(const std::vector<TriangleGPU>& meshTriangles);
+
+	// Size of the vertex data of every triangle, in whichever layout
+	size_t triangleBytes() const;
+
+	// Sets up the grid of a mesh from its bounds, for the quantized layout
+	void setGrid(Mesh& mesh) const;
+
+	// Object space to the space the BLAS was built in
+	static glm::mat4 objectToGrid(const Mesh& mesh);
+
+	GPUBVHBuilder::Target buildTarget(const Mesh& mesh) const;
+
+	static uint32_t instanceFlags(const Mesh& mesh);
+
+	BVH::AABB worldBounds(const Instance& instance) const;
+
+	void buildTLAS();
+
+	void refitTLAS();
+
+	void upload();
+
+	// Rebuild the TLAS once refitting has made its SAH cost this much worse than a fresh build
+	static constexpr float REBUILD_COST_RATIO{ 1.25f };
+
+	// Rebuild anyway after this many refits, even if the cost still looks fine
+	static constexpr uint32_t MAX_REFITS_BEFORE_REBUILD{ 600 };
+
+	BVH::BuildMode buildMode;
+	BVH::NodeLayout blasLayout;
+	TriangleLayout triangleLayout;
+
+	// Only created once there is a dynamic mesh, since it compiles a handful of shaders
+	std::unique_ptr<GPUBVHBuilder> gpuBuilder{};
+
+	// Only one of triangleEdges, vertices + triangleIndices or quantizedTriangles is filled, depending on the layout
+	std::vector<TriangleEdgesGPU> triangleEdges{};
+	std::vector<TriangleQuantizedGPU> quantizedTriangles{};
+	std::vector<glm::vec4> vertices{};
+	std::vector<uint32_t> triangleIndices{};
+	std::vector<TriangleShadingGPU> triangleShading{};
+	std::vector<BVHNodeGPU> blasNodes{};
+	std::vector<WideBVHNodeGPU<4>> wide4BLASNodes{};
+	std::vector<WideBVHNodeGPU<8>> wide8BLASNodes{};
+	std::vector<Mesh> meshes{};
+	std::vector<Instance> instances{};
+
+	std::vector<InstanceGPU> gpuInstances{};
+	std::vector<BVHNodeGPU> tlasNodes{};
+
+	// Where each instance ended up in gpuInstances after sorting them for the TLAS
+	std::vector<uint32_t> instanceSlots{};
+	std::vector<uint32_t> dirtyInstances{};
+
+	float builtTLASCost{ 0.0f };
+	uint32_t refitsSinceBuild{ 0 };
+
+	unsigned int triangleSSBO{ 0 };
+	unsigned int triangleShadingSSBO{ 0 };
+	unsigned int triangleIndexSSBO{ 0 };
+	unsigned int blasSSBO{ 0 };
+	unsigned int instanceSSBO{ 0 };
+	unsigned int tlasSSBO{ 0 };
+	unsigned int wideBLASSSBO{ 0 };
+};
+
+#endif // !ACCELERATION_STRUCTURE_H
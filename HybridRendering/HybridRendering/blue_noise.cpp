@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "blue_noise.h"
+
+namespace BlueNoise {
+    namespace {
+        // Width of the Gaussian that measures how crowded a pixel is, 1.5 is what the paper uses
+        constexpr float SIGMA{ 1.5f };
+
+        // Keeps track of which pixels are set and how close every pixel is to the set ones
+        struct Pattern {
+            uint32_t size;
+            std::vector<float> kernel;
+            std::vector<bool> set;
+            std::vector<float> energy;
+
+            explicit Pattern(uint32_t _size)
+                : size{ _size }
+                , kernel(size_t{ _size } * _size)
+                , set(size_t{ _size } * _size, false)
+                , energy(size_t{ _size } * _size, 0.0f)
+            {
+                // Distances wrap around, which is what makes the tile seamless
+                for (uint32_t y{ 0 }; y < size; ++y) {
+                    for (uint32_t x{ 0 }; x < size; ++x) {
+                        const float dx{ static_cast<float>(std::min(x, size - x)) };
+                        const float dy{ static_cast<float>(std::min(y, size - y)) };
+                        kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+                    }
+                }
+            }
+
+            void toggle(uint32_t index) {
+                set[index] = !set[index];
+                const float sign{ set[index] ? 1.0f : -1.0f };
+                const uint32_t centerX{ index % size };
+                const uint32_t centerY{ index / size };
+                for (uint32_t y{ 0 }; y < size; ++y) {
+                    const float* row{ &kernel[((y + size - centerY) % size) * size] };
+                    for (uint32_t x{ 0 }; x < size; ++x) {
+                        const uint32_t dx{ x >= centerX ? x - centerX : x + size - centerX };
+                        energy[y * size + x] += sign * row[dx];
+                    }
+                }
+            }
+
+            // The set pixel with the most set neighbours
+            uint32_t tightestCluster() const {
+                uint32_t best{ 0 };
+                float bestEnergy{ -std::numeric_limits<float>::max() };
+                for (uint32_t i{ 0 }; i < energy.size(); ++i) {
+                    if (set[i] && energy[i] > bestEnergy) {
+                        best = i;
+                        bestEnergy = energy[i];
+                    }
+                }
+                return best;
+            }
+
+            // The empty pixel furthest from any set one
+            uint32_t largestVoid() const {
+                uint32_t best{ 0 };
+                float bestEnergy{ std::numeric_limits<float>::max() };
+                for (uint32_t i{ 0 }; i < energy.size(); ++i) {
+                    if (!set[i] && energy[i] < bestEnergy) {
+                        best = i;
+                        bestEnergy = energy[i];
+                    }
+                }
+                return best;
+            }
+        };
+    }
+
+    std::vector<float> generate(uint32_t size, uint32_t seed) {
+        const uint32_t pixelCount{ size * size };
+        Pattern pattern{ size };
+
+        // Start with a tenth of the pixels set at random
+        std::mt19937 rng{ seed };
+        std::uniform_int_distribution<uint32_t> pixel{ 0, pixelCount - 1 };
+        const uint32_t initialCount{ std::max(pixelCount / 10, 1u) };
+        for (uint32_t count{ 0 }; count < initialCount;) {
+            const uint32_t index{ pixel(rng) };
+            if (!pattern.set[index]) {
+                pattern.toggle(index);
+                ++count;
+            }
+        }
+
+        // Then move the most crowded pixel into the emptiest spot until that doesn't change anything.
+        // Float noise in the energies could make two pixels trade places forever, hence the limit.
+        for (uint32_t step{ 0 }; step < pixelCount; ++step) {
+            const uint32_t cluster{ pattern.tightestCluster() };
+            pattern.toggle(cluster);
+            const uint32_t gap{ pattern.largestVoid() };
+            pattern.toggle(gap);
+            if (gap == cluster)
+                break;
+        }
+
+        const Pattern prototype{ pattern };
+        std::vector<float> ranks(pixelCount);
+
+        // The initial pixels get the lowest ranks, taking out the most crowded one first, so it ranks highest
+        for (uint32_t rank{ initialCount }; rank-- > 0;) {
+            const uint32_t cluster{ pattern.tightestCluster() };
+            pattern.toggle(cluster);
+            ranks[cluster] = static_cast<float>(rank);
+        }
+
+        // And everything else fills the largest remaining gap. The paper switches to the tightest
+        // cluster of empty pixels past the halfway point, but since the energy of the empty pixels
+        // is the total minus that of the set ones, that is the same pixel.
+        pattern = prototype;
+        for (uint32_t rank{ initialCount }; rank < pixelCount; ++rank) {
+            const uint32_t gap{ pattern.largestVoid() };
+            pattern.toggle(gap);
+            ranks[gap] = static_cast<float>(rank);
+        }
+
+        for (float& rank : ranks)
+            rank /= static_cast<float>(pixelCount);
+
+        return ranks;
+    }
+
+    unsigned int createTexture() {
+        const auto start{ std::chrono::steady_clock::now() };
+
+        const std::vector<float> first{ generate(TILE_SIZE, 1) };
+        const std::vector<float> second{ generate(TILE_SIZE, 2) };
+        std::vector<float> texels(2 * first.size());
+        for (size_t i{ 0 }; i < first.size(); ++i) {
+            texels[2 * i] = first[i];
+            texels[2 * i + 1] = second[i];
+        }
+
+        unsigned int texture{};
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, TILE_SIZE, TILE_SIZE, 0, GL_RG, GL_FLOAT, texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        const std::chrono::duration<double, std::milli> time{ std::chrono::steady_clock::now() - start };
+        PLOGD << "Generated " << TILE_SIZE << "x" << TILE_SIZE << " blue noise in " << time.count() << " ms";
+        return texture;
+    }
+}
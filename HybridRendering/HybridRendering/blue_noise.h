@@ -0,0 +1,23 @@
+#ifndef BLUE_NOISE_H
+#define BLUE_NOISE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace BlueNoise {
+	// Side length of the tile ray_trace.comp repeats over the screen
+	inline constexpr uint32_t TILE_SIZE{ 64 };
+
+	/*
+		Generates a size x size tile of blue noise with the void-and-cluster method
+		(Ulichney 1993). Every value in [0, 1) appears once, and neighbouring pixels are
+		as far apart as possible, so the error left by a handful of samples looks like
+		fine grain instead of clumps. The tile wraps around seamlessly.
+	*/
+	std::vector<float> generate(uint32_t size, uint32_t seed);
+
+	// Creates a TILE_SIZE x TILE_SIZE RG32F texture with two independent tiles, set to repeat
+	unsigned int createTexture();
+}
+
+#endif // !BLUE_NOISE_H
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <array>
+
+#include "bvh.h"
+
+namespace BVH {
+    void AABB::grow(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void AABB::grow(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 AABB::centroid() const {
+        return (min + max) * 0.5f;
+    }
+
+    float AABB::surfaceArea() const {
+        // An empty box has min > max, we don't want it to contribute anything
+        if (min.x > max.x || min.y > max.y || min.z > max.z)
+            return 0.0f;
+
+        const glm::vec3 extent{ max - min };
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    AABB triangleBounds(const TriangleGPU& triangle) {
+        AABB bounds{};
+        bounds.grow(glm::vec3{ triangle.v0 });
+        bounds.grow(glm::vec3{ triangle.v1 });
+        bounds.grow(glm::vec3{ triangle.v2 });
+        return bounds;
+    }
+
+    AABB nodeBounds(const BVHNodeGPU& node) {
+        return AABB{ node.aabbMin, node.aabbMax };
+    }
+
+    namespace {
+        struct BuildState {
+            const std::vector<AABB>& primitiveBounds;
+            std::vector<glm::vec3> centroids;
+            std::vector<uint32_t>& primitiveOrder;
+            std::vector<BVHNodeGPU>& nodes;
+        };
+
+        struct Bin {
+            AABB bounds{};
+            uint32_t count{ 0 };
+        };
+
+        // Result of the binned SAH sweep. axis == -1 means no split was found.
+        struct Split {
+            int axis{ -1 };
+            int bin{ 0 };
+            float cost{ std::numeric_limits<float>::max() };
+        };
+
+        int binIndex(const glm::vec3& centroid, const AABB& centroidBounds, int axis) {
+            const float extent{ centroidBounds.max[axis] - centroidBounds.min[axis] };
+            const int bin{ static_cast<int>(SAH_BINS * (centroid[axis] - centroidBounds.min[axis]) / extent) };
+            return std::clamp(bin, 0, SAH_BINS - 1);
+        }
+
+        Split findBestSplit(const BuildState& state, uint32_t first, uint32_t count, const AABB& centroidBounds) {
+            Split best{};
+
+            for (int axis{ 0 }; axis < 3; ++axis) {
+                if (centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.0f)
+                    continue;
+
+                std::array<Bin, SAH_BINS> bins{};
+                for (uint32_t i{ first }; i < first + count; ++i) {
+                    const uint32_t primitive{ state.primitiveOrder[i] };
+                    Bin& bin{ bins[binIndex(state.centroids[primitive], centroidBounds, axis)] };
+                    bin.bounds.grow(state.primitiveBounds[primitive]);
+                    ++bin.count;
+                }
+
+                // Sweep from the right to get the area/count of everything right of each split plane
+                std::array<float, SAH_BINS - 1> rightArea{};
+                std::array<uint32_t, SAH_BINS - 1> rightCount{};
+                AABB rightBounds{};
+                uint32_t rightTotal{ 0 };
+                for (int i{ SAH_BINS - 1 }; i > 0; --i) {
+                    rightBounds.grow(bins[i].bounds);
+                    rightTotal += bins[i].count;
+                    rightArea[i - 1] = rightBounds.surfaceArea();
+                    rightCount[i - 1] = rightTotal;
+                }
+
+                // Then sweep from the left and evaluate the SAH at every split plane
+                AABB leftBounds{};
+                uint32_t leftTotal{ 0 };
+                for (int i{ 0 }; i < SAH_BINS - 1; ++i) {
+                    leftBounds.grow(bins[i].bounds);
+                    leftTotal += bins[i].count;
+                    if (leftTotal == 0 || rightCount[i] == 0)
+                        continue;
+
+                    const float cost{ leftBounds.surfaceArea() * leftTotal + rightArea[i] * rightCount[i] };
+                    if (cost < best.cost) {
+                        best.axis = axis;
+                        best.bin = i;
+                        best.cost = cost;
+                    }
+                }
+            }
+
+            return best;
+        }
+
+        void buildNode(BuildState& state, uint32_t first, uint32_t count) {
+            AABB bounds{};
+            AABB centroidBounds{};
+            for (uint32_t i{ first }; i < first + count; ++i) {
+                const uint32_t primitive{ state.primitiveOrder[i] };
+                bounds.grow(state.primitiveBounds[primitive]);
+                centroidBounds.grow(state.centroids[primitive]);
+            }
+
+            // In a depth-first layout a node's subtree occupies [index, index + size), so whatever
+            // comes right after the subtree is where traversal continues when the node is skipped.
+            const uint32_t nodeIndex{ static_cast<uint32_t>(state.nodes.size()) };
+            state.nodes.emplace_back(bounds.min, bounds.max, nodeIndex + 1, (first << COUNT_BITS) | count);
+
+            if (count <= 1)
+                return;
+
+            // Compare the SAH of the best split against just making this node a leaf.
+            // Traversal and intersection costs are both treated as 1.
+            const Split split{ findBestSplit(state, first, count, centroidBounds) };
+            const float leafCost{ static_cast<float>(count) };
+            const float splitCost{ 1.0f + split.cost / bounds.surfaceArea() };
+
+            if (count <= MAX_LEAF_SIZE && (split.axis == -1 || splitCost >= leafCost))
+                return;
+
+            uint32_t leftCount{ 0 };
+            if (split.axis != -1) {
+                auto begin{ state.primitiveOrder.begin() + first };
+                auto middle{ std::partition(begin, begin + count, [&](uint32_t primitive) {
+                    return binIndex(state.centroids[primitive], centroidBounds, split.axis) <= split.bin;
+                }) };
+                leftCount = static_cast<uint32_t>(middle - begin);
+            }
+
+            if (leftCount == 0 || leftCount == count) {
+                // Every centroid is in the same spot, so there is nothing smart to do here.
+                // We still have to split if a leaf can't hold this many primitives.
+                if (count <= COUNT_MASK)
+                    return;
+
+                leftCount = count / 2;
+            }
+
+            // Children are emitted depth-first, so the left child always directly follows us
+            state.nodes[nodeIndex].primitiveInfo = (nodeIndex + 1) << COUNT_BITS;
+            buildNode(state, first, leftCount);
+            buildNode(state, first + leftCount, count - leftCount);
+
+            state.nodes[nodeIndex].skipIndex = static_cast<uint32_t>(state.nodes.size());
+        }
+    }
+
+    std::vector<BVHNodeGPU> buildSAH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder) {
+        std::vector<BVHNodeGPU> nodes{};
+
+        primitiveOrder.resize(primitiveBounds.size());
+        for (uint32_t i{ 0 }; i < primitiveOrder.size(); ++i)
+            primitiveOrder[i] = i;
+
+        if (primitiveBounds.empty())
+            return nodes;
+
+        BuildState state{ primitiveBounds, {}, primitiveOrder, nodes };
+        state.centroids.reserve(primitiveBounds.size());
+        for (const AABB& bounds : primitiveBounds)
+            state.centroids.push_back(bounds.centroid());
+
+        nodes.reserve(2 * primitiveBounds.size());
+        buildNode(state, 0, static_cast<uint32_t>(primitiveBounds.size()));
+
+        // Skipping past the end of the array means we are done
+        for (BVHNodeGPU& node : nodes) {
+            if (node.skipIndex == nodes.size())
+                node.skipIndex = INVALID_INDEX;
+        }
+
+        return nodes;
+    }
+
+    std::vector<BVHNodeGPU> buildSAH(std::vector<TriangleGPU>& triangles) {
+        return build(BuildMode::sah, triangles);
+    }
+
+    std::vector<BVHNodeGPU> build(BuildMode mode, const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder) {
+        if (mode == BuildMode::lbvh)
+            return buildLBVH(primitiveBounds, primitiveOrder);
+
+        return buildSAH(primitiveBounds, primitiveOrder);
+    }
+
+    std::vector<BVHNodeGPU> build(BuildMode mode, std::vector<TriangleGPU>& triangles) {
+        std::vector<AABB> primitiveBounds{};
+        primitiveBounds.reserve(triangles.size());
+        for (const TriangleGPU& triangle : triangles)
+            primitiveBounds.push_back(triangleBounds(triangle));
+
+        std::vector<uint32_t> primitiveOrder{};
+        std::vector<BVHNodeGPU> nodes{ build(mode, primitiveBounds, primitiveOrder) };
+
+        std::vector<TriangleGPU> reordered{};
+        reordered.reserve(triangles.size());
+        for (uint32_t primitive : primitiveOrder)
+            reordered.push_back(triangles[primitive]);
+        triangles = std::move(reordered);
+
+        return nodes;
+    }
+
+    const char* buildModeName(BuildMode mode) {
+        switch (mode) {
+        case BuildMode::sah:
+            return "SAH";
+        case BuildMode::lbvh:
+            return "LBVH";
+        default:
+            return "Unknown";
+        }
+    }
+
+    const char* nodeLayoutName(NodeLayout layout) {
+        switch (layout) {
+        case NodeLayout::binary:
+            return "binary";
+        case NodeLayout::bvh4:
+            return "BVH4";
+        case NodeLayout::bvh8:
+            return "BVH8";
+        default:
+            return "Unknown";
+        }
+    }
+
+    AABB refit(std::vector<BVHNodeGPU>& nodes, uint32_t rootIndex, const std::vector<AABB>& primitiveBounds) {
+        BVHNodeGPU& node{ nodes[rootIndex] };
+        const uint32_t count{ node.primitiveInfo & COUNT_MASK };
+        const uint32_t index{ node.primitiveInfo >> COUNT_BITS };
+
+        AABB bounds{};
+        if (count != 0) {
+            for (uint32_t i{ index }; i < index + count; ++i)
+                bounds.grow(primitiveBounds[i]);
+        }
+        else {
+            // The right child is wherever traversal continues after the left child
+            bounds.grow(refit(nodes, index, primitiveBounds));
+            bounds.grow(refit(nodes, nodes[index].skipIndex, primitiveBounds));
+        }
+
+        // nodes[rootIndex] is still valid here, the recursion never resizes the vector
+        node.aabbMin = bounds.min;
+        node.aabbMax = bounds.max;
+        return bounds;
+    }
+
+    float sahCost(const std::vector<BVHNodeGPU>& nodes) {
+        if (nodes.empty())
+            return 0.0f;
+
+        float cost{ 0.0f };
+        for (const BVHNodeGPU& node : nodes) {
+            const uint32_t count{ node.primitiveInfo & COUNT_MASK };
+            cost += nodeBounds(node).surfaceArea() * (count == 0 ? 1.0f : static_cast<float>(count));
+        }
+
+        const float rootArea{ nodeBounds(nodes[0]).surfaceArea() };
+        return rootArea > 0.0f ? cost / rootArea : cost;
+    }
+}
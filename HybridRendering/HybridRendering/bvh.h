@@ -0,0 +1,124 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh_node_gpu.h"
+#include "triangle_gpu.h"
+#include "wide_bvh_node_gpu.h"
+
+namespace BVH {
+	// Marks the end of a stackless traversal (see BVHNodeGPU::skipIndex)
+	inline constexpr uint32_t INVALID_INDEX{ 0xFFFFFFFF };
+
+	// The lower bits of BVHNodeGPU::primitiveInfo hold the primitive count of a leaf
+	inline constexpr uint32_t COUNT_BITS{ 3 };
+	inline constexpr uint32_t COUNT_MASK{ (1u << COUNT_BITS) - 1u };
+
+	// Leaves are allowed to grow up to COUNT_MASK primitives, but the SAH only
+	// creates leaves larger than this when it can't find a useful split
+	inline constexpr uint32_t MAX_LEAF_SIZE{ 4 };
+
+	// Number of bins per axis when evaluating the SAH
+	inline constexpr int SAH_BINS{ 16 };
+
+	// Bits per axis of the Morton codes used by the LBVH builder
+	inline constexpr uint32_t MORTON_BITS_PER_AXIS{ 10 };
+
+	/*
+		Which builder to use for a scene
+	*/
+	enum class BuildMode {
+		sah, // 0, slower to build but produces better trees
+		lbvh, // 1, linear BVH from sorted Morton codes, built in parallel
+		num_options, // 2
+	};
+
+	/*
+		How BLAS nodes are stored on the GPU
+	*/
+	enum class NodeLayout {
+		binary, // 0, BVHNodeGPU, two full precision children
+		bvh4, // 1, WideBVHNodeGPU<4>, four quantized children
+		bvh8, // 2, WideBVHNodeGPU<8>, eight quantized children
+		num_options, // 3
+	};
+
+	// Size of the traversal stack ray_trace.comp uses for wide BVHs
+	inline constexpr uint32_t WIDE_STACK_SIZE{ 64 };
+
+	struct AABB {
+		glm::vec3 min{ std::numeric_limits<float>::max() };
+		glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+		void grow(const glm::vec3& point);
+		void grow(const AABB& other);
+		glm::vec3 centroid() const;
+		float surfaceArea() const;
+	};
+
+	AABB triangleBounds(const TriangleGPU& triangle);
+
+	AABB nodeBounds(const BVHNodeGPU& node);
+
+	/*
+		Builds a binned SAH BVH over the given primitive bounds. The nodes are returned
+		in depth-first order with their skip links filled in, and primitiveOrder is
+		filled with the primitive indices in the order the leaves reference them.
+	*/
+	std::vector<BVHNodeGPU> buildSAH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder);
+
+	/*
+		Convenience wrapper that builds a BVH over the triangles and reorders them
+		in place so that every leaf references a contiguous range.
+	*/
+	std::vector<BVHNodeGPU> buildSAH(std::vector<TriangleGPU>& triangles);
+
+	/*
+		Builds a linear BVH (Karras 2012) using every core: Morton codes of the primitive
+		centroids are radix sorted and every interior node is emitted independently. Leaves
+		hold a single primitive. The output layout follows the same rules as buildSAH(),
+		except that nodes are not in depth-first order.
+	*/
+	std::vector<BVHNodeGPU> buildLBVH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder);
+
+	// Runs whichever builder the mode asks for
+	std::vector<BVHNodeGPU> build(BuildMode mode, const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder);
+
+	// Builds over the triangles with the given mode and reorders them like buildSAH() does
+	std::vector<BVHNodeGPU> build(BuildMode mode, std::vector<TriangleGPU>& triangles);
+
+	const char* buildModeName(BuildMode mode);
+
+	/*
+		Collapses a binary BVH from any of the builders above into a wide one, by pulling the
+		largest interior grandchildren up until every node has WIDTH children (or only leaves).
+		Leaves keep referencing the same primitives. The wide nodes are returned in depth-first
+		order with the root first, and stackSize is set to the number of stack entries a
+		traversal of the result can need at most.
+	*/
+	template <uint32_t WIDTH>
+	std::vector<WideBVHNodeGPU<WIDTH>> collapse(const std::vector<BVHNodeGPU>& nodes, uint32_t& stackSize);
+
+	const char* nodeLayoutName(NodeLayout layout);
+
+	/*
+		Recomputes the bounds of the tree rooted at rootIndex bottom-up, without touching
+		its topology. primitiveBounds is indexed the same way the leaves index primitives.
+		Returns the new bounds of the root.
+	*/
+	AABB refit(std::vector<BVHNodeGPU>& nodes, uint32_t rootIndex, const std::vector<AABB>& primitiveBounds);
+
+	/*
+		SAH cost of a tree relative to its root's surface area, with traversal and
+		intersection costs both set to 1. Expects nodes[0] to be the root.
+		Useful to compare trees over the same primitives, lower is better.
+	*/
+	float sahCost(const std::vector<BVHNodeGPU>& nodes);
+}
+
+#endif // !BVH_H
@@ -0,0 +1,36 @@
+#ifndef BVH_NODE_GPU_H
+#define BVH_NODE_GPU_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// A single node of a flattened BVH. Each vec3 is followed by a uint so that the
+// struct lines up with the std430 layout in the shaders (32 bytes per node).
+//
+// Nodes are traversed without a stack: if the ray misses a node (or we are done
+// with a leaf) we jump to skipIndex, otherwise we descend into the left child.
+// An interior node's right child is always the skipIndex of its left child.
+struct BVHNodeGPU {
+	glm::vec3 aabbMin;
+	uint32_t skipIndex;     // next node to visit once this subtree is done, 0xFFFFFFFF ends traversal
+	glm::vec3 aabbMax;
+	uint32_t primitiveInfo; // (index << 3) | count, count == 0 means index is the left child
+
+    BVHNodeGPU(
+        const glm::vec3& _aabbMin,
+        const glm::vec3& _aabbMax,
+        uint32_t _skipIndex,
+        uint32_t _primitiveInfo
+    )
+        : aabbMin(_aabbMin)
+        , skipIndex(_skipIndex)
+        , aabbMax(_aabbMax)
+        , primitiveInfo(_primitiveInfo)
+    {
+    }
+};
+
+static_assert(sizeof(BVHNodeGPU) == 32, "BVHNodeGPU must match the std430 layout in the shaders");
+
+#endif // !BVH_NODE_GPU_H
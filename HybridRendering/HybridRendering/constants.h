@@ -5,6 +5,7 @@ namespace Constants {
 	inline constexpr unsigned int SCR_WIDTH{ 1920 };
 	inline constexpr unsigned int SCR_HEIGHT{ 1080 };
 	inline constexpr unsigned int NR_LIGHTS{ 1 };
+	inline constexpr unsigned int MAX_FILL_LIGHTS{ 1024 }; // unshadowed, only lit by the lighting pass
 	inline constexpr float LIGHT_RADIUS{ 0.25f };
 }
 
@@ -3,31 +3,103 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-const int NR_LIGHTS = 1;
-
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
-uniform sampler2DArray shadowMaps; // array so that we have one per light
+uniform sampler2DArray shadowMaps; // array so that we have one per shadowed light
+uniform sampler2DArray shadowRayCounts; // fraction of the shadow samples each pixel traced, per light
 
+// Every light, see light_gpu.h. The first shadowedLights have a layer in shadowMaps, the rest
+// are fill lights the ray tracer doesn't trace.
 struct Light {
     vec3 Position;
+    float Radius;
     vec3 Color;
-    
+    float MaxDistance;
     float Linear;
     float Quadratic;
-    float MaxDistance;
-    float Radius;
 };
 
-uniform Light lights[NR_LIGHTS];
+layout(std430, binding = 13) readonly buffer Lights {
+    Light lights[];
+};
+
+uniform int shadowedLights;
 uniform vec3 viewPos;
 
+// Tiled lighting only loops over the lights LightCulling found for the pixel's tile, instead
+// of all of them, see light_cull.comp
+uniform bool tiledLighting;
+
+// Same as LightCulling::TILE_SIZE and LightCulling::TOO_MANY_LIGHTS
+#define TILE_SIZE 16
+#define TOO_MANY_LIGHTS 0xFFFFFFFFu
+
+layout(std430, binding = 16) readonly buffer LightTiles {
+    uvec2 tileRanges[];
+};
+
+layout(std430, binding = 17) readonly buffer LightIndices {
+    uint lightIndexCount;
+    uint overflowedTiles;
+    uint lightIndices[];
+};
+
+// Reservoir lighting shades only the light each pixel's reservoir picked, weighted so that it
+// stands in for all of them, see LightReservoirs. Its shadow is already in the weight.
+uniform bool reservoirLighting;
+
+// See restir_sample.comp
+struct Reservoir {
+    uint light;
+    float weightSum;
+    float M;
+    float W;
+};
+
+layout(std430, binding = 14) readonly buffer Reservoirs {
+    Reservoir reservoirs[];
+};
+
 // How/What we want to render
 // 0 ==> Default
 // 1 ==> Shadows
+// 2 ==> Rays per pixel, blue for none up to red for the full sample count
+// 3 ==> Lights per tile, blue for none up to red for 64 or more
 uniform int renderingMode;
 
+// Diffuse and specular light from one light, without its shadow
+vec3 shade(Light light, vec3 FragPos, vec3 Normal, vec3 viewDir, vec3 Diffuse, float Specular)
+{
+    // calculate distance between light source and current fragment
+    float distance = length(light.Position - FragPos);
+    if (distance >= light.MaxDistance)
+        return vec3(0.0);
+
+    // diffuse
+    vec3 lightDir = normalize(light.Position - FragPos);
+    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * light.Color;
+    // specular
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
+    vec3 specular = light.Color * spec * Specular;
+    // attenuation
+    float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    return diffuse + specular;
+}
+
+// Light i with its ray traced shadow, if it has one
+vec3 shadeShadowed(int i, vec3 FragPos, vec3 Normal, vec3 viewDir, vec3 Diffuse, float Specular)
+{
+    float shadow = i < shadowedLights ? texture(shadowMaps, vec3(TexCoords, i)).r : 1.0; // Since this only has an R channel
+
+    // In Shadow
+    return shade(lights[i], FragPos, Normal, viewDir, Diffuse, Specular) * shadow;
+}
+
 void main()
 {             
     // retrieve data from gbuffer
@@ -39,35 +111,35 @@ void main()
     // then calculate lighting as usual
     vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
     vec3 viewDir  = normalize(viewPos - FragPos);
-    for(int i = 0; i < NR_LIGHTS; ++i)
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 tile = pixel / TILE_SIZE;
+    uvec2 tileRange = tiledLighting ? tileRanges[tile.y * ((textureSize(gPosition, 0).x + TILE_SIZE - 1) / TILE_SIZE) + tile.x] : uvec2(0u);
+
+    if (reservoirLighting)
+    {
+        Reservoir r = reservoirs[pixel.y * textureSize(gPosition, 0).x + pixel.x];
+        if (r.W > 0.0 && r.light < uint(lights.length()))
+            lighting += shade(lights[r.light], FragPos, Normal, viewDir, Diffuse, Specular) * r.W;
+    }
+    else if (tiledLighting && tileRange.y != TOO_MANY_LIGHTS)
+    {
+        for(uint i = 0u; i < tileRange.y; ++i)
+            lighting += shadeShadowed(int(lightIndices[tileRange.x + i]), FragPos, Normal, viewDir, Diffuse, Specular);
+    }
+    else
     {
-        // calculate distance between light source and current fragment
-        float distance = length(lights[i].Position - FragPos);
-        if(distance < lights[i].MaxDistance)
-        {
-            // diffuse
-            vec3 lightDir = normalize(lights[i].Position - FragPos);
-            vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lights[i].Color;
-            // specular
-            vec3 halfwayDir = normalize(lightDir + viewDir);  
-            float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-            vec3 specular = lights[i].Color * spec * Specular;
-            // attenuation
-            float attenuation = 1.0 / (1.0 + lights[i].Linear * distance + lights[i].Quadratic * distance * distance);
-            diffuse *= attenuation;
-            specular *= attenuation;
-
-            float shadow = texture(shadowMaps, vec3(TexCoords, i)).r; // Since this only has an R channel
-            
-            // In Shadow
-
-            lighting += (diffuse + specular) * shadow;
-            
-        }
+        for(int i = 0; i < lights.length(); ++i)
+            lighting += shadeShadowed(i, FragPos, Normal, viewDir, Diffuse, Specular);
     }
 
     if (renderingMode == 0) {
         FragColor = vec4(lighting, 1.0);
+    } else if (renderingMode == 2) {
+        float rays = texture(shadowRayCounts, vec3(TexCoords, 0)).r;
+        FragColor = vec4(rays, 0.0, 1.0 - rays, 1.0f);
+    } else if (renderingMode == 3) {
+        float count = min(float(tileRange.y) / 64.0, 1.0);
+        FragColor = vec4(count, 0.0, 1.0 - count, 1.0f);
     } else {
         // Shadows
         float Shadow = texture(shadowMaps, vec3(TexCoords, 0)).r;
@@ -19,6 +19,9 @@ uniform int renderingMode;
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
+// Same ids as the instances in the acceleration structure, the shadow denoiser won't blur across them
+uniform uint objectID;
+
 void main()
 {    
     // store the fragment position vector in the first gbuffer texture
@@ -27,6 +30,8 @@ void main()
     // also store the per-fragment normals into the gbuffer
     gNormal = normalize(Normal);
 
+    FragObjectID = objectID;
+
     if(renderingMode == 1){
         gAlbedoSpec = vec4(FragPos, 1.0f);
     } else if(renderingMode == 2){
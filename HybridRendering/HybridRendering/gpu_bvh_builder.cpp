@@ -0,0 +1,313 @@
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "bvh.h"
+#include "gpu_bvh_builder.h"
+
+namespace {
+    // SSBO bindings used by the build passes. 3 and 4 are the same as in ray_trace.comp.
+    constexpr unsigned int TRIANGLE_BINDING{ 3 };
+    constexpr unsigned int NODE_BINDING{ 4 };
+    constexpr unsigned int SOURCE_BINDING{ 7 };
+    constexpr unsigned int STATE_BINDING{ 8 };
+    constexpr unsigned int KEYS_IN_BINDING{ 9 };
+    constexpr unsigned int VALUES_IN_BINDING{ 10 };
+    constexpr unsigned int KEYS_OUT_BINDING{ 11 };
+    constexpr unsigned int VALUES_OUT_BINDING{ 12 };
+    constexpr unsigned int HISTOGRAM_BINDING{ 13 };
+    constexpr unsigned int CHILDREN_BINDING{ 14 };
+    constexpr unsigned int PARENT_BINDING{ 15 };
+    constexpr unsigned int ARRIVAL_BINDING{ 16 };
+    constexpr unsigned int SHADING_BINDING{ 17 };
+
+    constexpr uint32_t RADIX_BITS{ 8 };
+    constexpr uint32_t RADIX_SIZE{ 1u << RADIX_BITS };
+
+    void resizeBuffer(unsigned int& ssbo, size_t size) {
+        if (ssbo == 0)
+            glGenBuffers(1, &ssbo);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void clearBuffer(unsigned int ssbo, uint32_t value) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    template <typename T>
+    std::vector<T> readBuffer(unsigned int ssbo, size_t first, size_t count, const T& fill) {
+        std::vector<T> data(count, fill);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(T), count * sizeof(T), data.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return data;
+    }
+
+    uint32_t groupCount(uint32_t invocations, uint32_t groupSize) {
+        return (invocations + groupSize - 1) / groupSize;
+    }
+}
+
+GPUBVHBuilder::GPUBVHBuilder(TriangleLayout triangleLayout)
+    : triangleLayout{ triangleLayout }
+    , nodesShader{ "bvh_build_nodes.comp", std::string{ triangleLayoutDefines(triangleLayout) } }
+{
+    glGenBuffers(1, &stateSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 6 * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GPUBVHBuilder::~GPUBVHBuilder() {
+    const unsigned int buffers[]{ stateSSBO, keySSBOs[0], keySSBOs[1], valueSSBOs[0], valueSSBOs[1], histogramSSBO, childrenSSBO, parentSSBO, arrivalSSBO };
+    glDeleteBuffers(static_cast<GLsizei>(std::size(buffers)), buffers);
+
+    const Shader* shaders[]{ &boundsShader, &mortonShader, &radixCountShader, &radixScanShader, &radixScatterShader, &hierarchyShader, &nodesShader, &propagateShader };
+    for (const Shader* shader : shaders)
+        glDeleteProgram(shader->ID);
+}
+
+void GPUBVHBuilder::build(unsigned int sourceSSBO, uint32_t triangleCount, const Target& target) {
+    if (triangleCount == 0) {
+        // Nothing to hit, but the root still has to exist. An inverted box is never entered.
+        const BVH::AABB empty{};
+        const BVHNodeGPU root{ empty.min, empty.max, BVH::INVALID_INDEX, 1u };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, target.nodeSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, target.firstNode * sizeof(BVHNodeGPU), sizeof(BVHNodeGPU), &root);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return;
+    }
+
+    reserve(triangleCount);
+
+    const uint32_t tileCount{ groupCount(triangleCount, WORKGROUP_SIZE) };
+    const uint32_t interiorCount{ triangleCount - 1 };
+
+    // Empty centroid bounds, in the sortable uint form that bvh_build_bounds.comp uses
+    const uint32_t emptyState[6]{ 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stateSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyState), emptyState);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    clearBuffer(parentSSBO, BVH::INVALID_INDEX);
+    clearBuffer(arrivalSSBO, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRIANGLE_BINDING, target.triangleSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_BINDING, target.shadingSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, target.nodeSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, sourceSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATE_BINDING, stateSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HISTOGRAM_BINDING, histogramSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CHILDREN_BINDING, childrenSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARENT_BINDING, parentSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ARRIVAL_BINDING, arrivalSSBO);
+
+    // 1. Centroid bounds
+    boundsShader.use();
+    boundsShader.setUInt("primitiveCount", triangleCount);
+    boundsShader.dispatch(tileCount, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. Morton codes, into the first key/value buffers
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEYS_OUT_BINDING, keySSBOs[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VALUES_OUT_BINDING, valueSSBOs[0]);
+    mortonShader.use();
+    mortonShader.setUInt("primitiveCount", triangleCount);
+    mortonShader.dispatch(tileCount, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 3. Radix sort, ping-ponging between the two sets of buffers
+    int current{ 0 };
+    for (uint32_t shift{ 0 }; shift < 3 * BVH::MORTON_BITS_PER_AXIS; shift += RADIX_BITS) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEYS_IN_BINDING, keySSBOs[current]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VALUES_IN_BINDING, valueSSBOs[current]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEYS_OUT_BINDING, keySSBOs[1 - current]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VALUES_OUT_BINDING, valueSSBOs[1 - current]);
+
+        radixCountShader.use();
+        radixCountShader.setUInt("primitiveCount", triangleCount);
+        radixCountShader.setUInt("tileCount", tileCount);
+        radixCountShader.setUInt("shift", shift);
+        radixCountShader.dispatch(tileCount, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        radixScanShader.use();
+        radixScanShader.setUInt("histogramSize", tileCount * RADIX_SIZE);
+        radixScanShader.dispatch(1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        radixScatterShader.use();
+        radixScatterShader.setUInt("primitiveCount", triangleCount);
+        radixScatterShader.setUInt("tileCount", tileCount);
+        radixScatterShader.setUInt("shift", shift);
+        radixScatterShader.dispatch(tileCount, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        current = 1 - current;
+    }
+
+    // The sorted keys and values are read from the "in" bindings from here on
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEYS_IN_BINDING, keySSBOs[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VALUES_IN_BINDING, valueSSBOs[current]);
+
+    // 4. Hierarchy
+    if (interiorCount > 0) {
+        hierarchyShader.use();
+        hierarchyShader.setUInt("primitiveCount", triangleCount);
+        hierarchyShader.dispatch(groupCount(interiorCount, WORKGROUP_SIZE), 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // 5. Nodes, skip links and sorted triangles
+    nodesShader.use();
+    nodesShader.setUInt("primitiveCount", triangleCount);
+    nodesShader.setUInt("firstTriangle", target.firstTriangle);
+    nodesShader.setUInt("firstVertex", target.firstVertex);
+    nodesShader.setUInt("firstNode", target.firstNode);
+    nodesShader.setVec3("gridOrigin", target.gridOrigin);
+    nodesShader.setVec3("gridScale", target.gridScale);
+    nodesShader.dispatch(groupCount(nodeCount(triangleCount), WORKGROUP_SIZE), 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 6. Interior bounds
+    if (interiorCount > 0) {
+        propagateShader.use();
+        propagateShader.setUInt("primitiveCount", triangleCount);
+        propagateShader.setUInt("firstNode", target.firstNode);
+        propagateShader.dispatch(tileCount, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+bool GPUBVHBuilder::validate(unsigned int sourceSSBO, uint32_t triangleCount, const Target& target) const {
+    if (triangleCount == 0)
+        return true;
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    const TriangleGPU emptyTriangle{ glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, glm::vec4{ 0.0f }, 0 };
+    const BVHNodeGPU emptyNode{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, 0, 0 };
+    const uint32_t count{ nodeCount(triangleCount) };
+
+    std::vector<TriangleGPU> cpuTriangles{ readBuffer(sourceSSBO, 0, triangleCount, emptyTriangle) };
+
+    // The GPU tree is over the quantized triangles, so the CPU one has to be as well
+    if (triangleLayout == TriangleLayout::quantized) {
+        for (TriangleGPU& triangle : cpuTriangles)
+            triangle = quantizeToGrid(triangle, target.gridOrigin, target.gridScale);
+    }
+    const std::vector<TriangleShadingGPU> gpuShading{ readBuffer(target.shadingSSBO, target.firstTriangle, triangleCount, TriangleShadingGPU{ emptyTriangle }) };
+    std::vector<BVHNodeGPU> gpuNodes{ readBuffer(target.nodeSSBO, target.firstNode, count, emptyNode) };
+
+    // The first vertex of every sorted triangle, wherever the layout keeps it
+    std::vector<glm::vec4> gpuFirstVertices(triangleCount);
+    if (triangleLayout == TriangleLayout::indexed) {
+        const std::vector<glm::vec4> vertices{ readBuffer(target.triangleSSBO, target.firstVertex, 3 * size_t{ triangleCount }, glm::vec4{ 0.0f }) };
+        for (uint32_t i{ 0 }; i < triangleCount; ++i)
+            gpuFirstVertices[i] = vertices[3 * i];
+    }
+    else if (triangleLayout == TriangleLayout::quantized) {
+        const std::vector<TriangleQuantizedGPU> quantized{ readBuffer(target.triangleSSBO, target.firstTriangle, triangleCount, TriangleQuantizedGPU{ emptyTriangle }) };
+        for (uint32_t i{ 0 }; i < triangleCount; ++i)
+            gpuFirstVertices[i] = quantized[i].v0();
+    }
+    else {
+        const std::vector<TriangleEdgesGPU> edges{ readBuffer(target.triangleSSBO, target.firstTriangle, triangleCount, TriangleEdgesGPU{ emptyTriangle }) };
+        for (uint32_t i{ 0 }; i < triangleCount; ++i)
+            gpuFirstVertices[i] = edges[i].v0;
+    }
+
+    // Move the GPU nodes back so they index from 0 like the CPU ones
+    for (BVHNodeGPU& node : gpuNodes) {
+        if (node.skipIndex != BVH::INVALID_INDEX)
+            node.skipIndex -= target.firstNode;
+
+        const uint32_t primitiveCount{ node.primitiveInfo & BVH::COUNT_MASK };
+        const uint32_t index{ node.primitiveInfo >> BVH::COUNT_BITS };
+        node.primitiveInfo = ((index - (primitiveCount == 0 ? target.firstNode : target.firstTriangle)) << BVH::COUNT_BITS) | primitiveCount;
+    }
+
+    // First make sure the GPU tree is usable on its own: every triangle is referenced
+    // once, and every node's bounds contain its children's
+    std::vector<uint32_t> references(triangleCount, 0);
+    uint32_t brokenNodes{ 0 };
+    for (const BVHNodeGPU& node : gpuNodes) {
+        const uint32_t primitiveCount{ node.primitiveInfo & BVH::COUNT_MASK };
+        const uint32_t index{ node.primitiveInfo >> BVH::COUNT_BITS };
+
+        if (primitiveCount > 0) {
+            for (uint32_t i{ index }; i < index + primitiveCount && i < triangleCount; ++i)
+                ++references[i];
+            continue;
+        }
+
+        if (index >= count || gpuNodes[index].skipIndex >= count) {
+            ++brokenNodes;
+            continue;
+        }
+
+        const BVHNodeGPU& left{ gpuNodes[index] };
+        const BVHNodeGPU& right{ gpuNodes[left.skipIndex] };
+        const bool contains{
+            glm::all(glm::lessThanEqual(node.aabbMin, glm::min(left.aabbMin, right.aabbMin))) &&
+            glm::all(glm::greaterThanEqual(node.aabbMax, glm::max(left.aabbMax, right.aabbMax)))
+        };
+        if (!contains)
+            ++brokenNodes;
+    }
+
+    uint32_t badReferences{ 0 };
+    for (uint32_t referenceCount : references)
+        badReferences += referenceCount != 1 ? 1 : 0;
+
+    if (brokenNodes > 0 || badReferences > 0) {
+        PLOGE << "GPU BVH is broken: " << brokenNodes << " bad nodes, " << badReferences << " triangles not referenced exactly once";
+        return false;
+    }
+
+    // Then compare against the CPU builder, which should produce the exact same tree. Drivers
+    // are allowed to round the Morton code math a little differently, so differences are only reported.
+    const std::vector<BVHNodeGPU> cpuNodes{ BVH::build(BVH::BuildMode::lbvh, cpuTriangles) };
+
+    uint32_t differentNodes{ 0 };
+    for (uint32_t i{ 0 }; i < count; ++i) {
+        const BVHNodeGPU& cpu{ cpuNodes[i] };
+        const BVHNodeGPU& gpu{ gpuNodes[i] };
+        if (cpu.aabbMin != gpu.aabbMin || cpu.aabbMax != gpu.aabbMax || cpu.skipIndex != gpu.skipIndex || cpu.primitiveInfo != gpu.primitiveInfo)
+            ++differentNodes;
+    }
+
+    uint32_t differentTriangles{ 0 };
+    for (uint32_t i{ 0 }; i < triangleCount; ++i)
+        differentTriangles += cpuTriangles[i].id != gpuShading[i].id || cpuTriangles[i].v0 != gpuFirstVertices[i] ? 1 : 0;
+
+    PLOGD << "GPU BVH (" << triangleCount << " triangles) validated: " << differentNodes << " of " << count << " nodes and "
+        << differentTriangles << " triangles differ from the CPU builder, SAH cost " << BVH::sahCost(gpuNodes) << " (CPU " << BVH::sahCost(cpuNodes) << ")";
+    return true;
+}
+
+void GPUBVHBuilder::reserve(uint32_t triangleCount) {
+    if (triangleCount <= capacity)
+        return;
+
+    // Leave some headroom so that a slowly growing mesh doesn't reallocate every frame
+    capacity = triangleCount + triangleCount / 2;
+    const uint32_t tileCount{ groupCount(capacity, WORKGROUP_SIZE) };
+
+    for (int i{ 0 }; i < 2; ++i) {
+        resizeBuffer(keySSBOs[i], capacity * sizeof(uint32_t));
+        resizeBuffer(valueSSBOs[i], capacity * sizeof(uint32_t));
+    }
+    resizeBuffer(histogramSSBO, tileCount * RADIX_SIZE * sizeof(uint32_t));
+    resizeBuffer(childrenSSBO, capacity * 2 * sizeof(uint32_t));
+    resizeBuffer(parentSSBO, nodeCount(capacity) * sizeof(uint32_t));
+    resizeBuffer(arrivalSSBO, capacity * sizeof(uint32_t));
+
+    PLOGD << "Resized GPU BVH scratch buffers for " << capacity << " triangles";
+}
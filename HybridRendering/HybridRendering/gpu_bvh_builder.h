@@ -0,0 +1,98 @@
+#ifndef GPU_BVH_BUILDER_H
+#define GPU_BVH_BUILDER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "triangle_gpu.h"
+
+/*
+	Builds a linear BVH over a triangle SSBO entirely on the GPU, so that geometry that
+	changes every frame never has to come back to the CPU. It runs the same algorithm as
+	BVH::buildLBVH(), one compute pass per step:
+
+		bvh_build_bounds.comp    ==> centroid bounds
+		bvh_build_morton.comp    ==> Morton codes
+		bvh_radix_*.comp         ==> stable radix sort, 8 bits per pass
+		bvh_build_hierarchy.comp ==> children and parents of every interior node
+		bvh_build_nodes.comp     ==> leaves, skip links and the sorted triangles
+		bvh_build_propagate.comp ==> interior bounds, bottom-up
+
+	The nodes and triangles are written straight into the buffers ray_trace.comp reads,
+	at the given offsets, so the result can be traversed like any other BLAS.
+*/
+class GPUBVHBuilder {
+public:
+	/*
+		Where build() writes to. The sorted triangles go to triangleSSBO and shadingSSBO starting
+		at firstTriangle. For TriangleLayout::indexed, triangleSSBO holds the vertices instead and
+		every triangle gets three of its own starting at firstVertex. Its indices have to point
+		there already, since the GPU never writes them. For TriangleLayout::quantized, the
+		triangles are snapped to the grid given by gridOrigin and gridScale, see quantizeToGrid(),
+		and the node bounds are in grid space. The nodes go to nodeSSBO starting at firstNode,
+		which is also where the root ends up.
+	*/
+	struct Target {
+		unsigned int triangleSSBO;
+		unsigned int shadingSSBO;
+		uint32_t firstTriangle;
+		uint32_t firstVertex;
+		unsigned int nodeSSBO;
+		uint32_t firstNode;
+		glm::vec3 gridOrigin;
+		glm::vec3 gridScale;
+	};
+
+	// Triangles are written in the given layout
+	explicit GPUBVHBuilder(TriangleLayout triangleLayout);
+	~GPUBVHBuilder();
+
+	GPUBVHBuilder(const GPUBVHBuilder&) = delete;
+	GPUBVHBuilder& operator=(const GPUBVHBuilder&) = delete;
+
+	// Builds over the first triangleCount TriangleGPUs of sourceSSBO. The target buffers need room for the sizes below.
+	void build(unsigned int sourceSSBO, uint32_t triangleCount, const Target& target);
+
+	/*
+		Reads back the result of build() with the same arguments and checks it against
+		BVH::buildLBVH() on the CPU. This stalls the pipeline, so it's only meant for testing
+		the GPU path (it runs fine on llvmpipe). Returns false if the GPU tree is broken,
+		nodes that only differ from the CPU tree are reported but still count as valid.
+	*/
+	bool validate(unsigned int sourceSSBO, uint32_t triangleCount, const Target& target) const;
+
+	// Number of nodes build() writes for this many triangles, always at least one
+	static uint32_t nodeCount(uint32_t triangleCount) { return triangleCount > 0 ? 2 * triangleCount - 1 : 1; }
+
+private:
+	// Grows the scratch buffers so that they fit triangleCount triangles
+	void reserve(uint32_t triangleCount);
+
+	// Every pass uses workgroups of this many invocations, and the radix sort tiles are the same size
+	static constexpr uint32_t WORKGROUP_SIZE{ 256 };
+
+	TriangleLayout triangleLayout;
+
+	Shader boundsShader{ "bvh_build_bounds.comp" };
+	Shader mortonShader{ "bvh_build_morton.comp" };
+	Shader radixCountShader{ "bvh_radix_count.comp" };
+	Shader radixScanShader{ "bvh_radix_scan.comp" };
+	Shader radixScatterShader{ "bvh_radix_scatter.comp" };
+	Shader hierarchyShader{ "bvh_build_hierarchy.comp" };
+	Shader nodesShader; // compiled for the triangle layout
+	Shader propagateShader{ "bvh_build_propagate.comp" };
+
+	uint32_t capacity{ 0 };
+
+	unsigned int stateSSBO{ 0 };
+	unsigned int keySSBOs[2]{ 0, 0 };
+	unsigned int valueSSBOs[2]{ 0, 0 };
+	unsigned int histogramSSBO{ 0 };
+	unsigned int childrenSSBO{ 0 };
+	unsigned int parentSSBO{ 0 };
+	unsigned int arrivalSSBO{ 0 };
+};
+
+#endif // !GPU_BVH_BUILDER_H
@@ -0,0 +1,152 @@
+#include <string>
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <plog/Log.h>
+
+#include "hybrid_shadows.h"
+
+namespace {
+    // Texture units shadow_classify.comp samples from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+    constexpr int SHADOW_CUBES_UNIT{ 2 };
+
+    // Indirect dispatch arguments and pixel count in front of the pixels, see TracedPixels in shadow_classify.comp
+    constexpr GLsizeiptr PIXEL_LIST_HEADER_SIZE{ 4 * sizeof(uint32_t) };
+
+    constexpr float NEAR_PLANE{ 0.05f };
+}
+
+HybridShadows::HybridShadows(unsigned int width, unsigned int height, unsigned int lights)
+    : width{ width }
+    , height{ height }
+{
+    glGenTextures(1, &shadowCubes);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, shadowCubes);
+    glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 6 * lights);
+
+    // Filtering would average the distances of blockers and whatever is behind them
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+    glGenFramebuffers(1, &shadowFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowCubes, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        PLOGE << "Shadow cube map framebuffer not complete!";
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Room for every pixel of the screen
+    glGenBuffers(1, &pixelListSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, PIXEL_LIST_HEADER_SIZE + static_cast<GLsizeiptr>(width) * height * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    classifyShader.use();
+    classifyShader.setInt("gPosition", POSITION_UNIT);
+    classifyShader.setInt("gNormal", NORMAL_UNIT);
+    classifyShader.setInt("shadowCubes", SHADOW_CUBES_UNIT);
+    classifyShader.setInt("shadowMapSize", SHADOW_MAP_SIZE);
+
+    PLOGD << "Shadow cube maps: " << lights << " of " << SHADOW_MAP_SIZE << "x" << SHADOW_MAP_SIZE;
+}
+
+HybridShadows::~HybridShadows() {
+    glDeleteTextures(1, &shadowCubes);
+    glDeleteFramebuffers(1, &shadowFBO);
+    glDeleteBuffers(1, &pixelListSSBO);
+    glDeleteProgram(depthShader.ID);
+    glDeleteProgram(classifyShader.ID);
+}
+
+void HybridShadows::renderShadowMaps(std::span<const glm::vec3> lightPositions, std::span<const float> farPlanes,
+    const std::function<void(const Shader&)>& drawScene) {
+    GLint viewport[4]{};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    depthShader.use();
+    for (size_t light{ 0 }; light < lightPositions.size(); ++light) {
+        const glm::vec3& position{ lightPositions[light] };
+        const glm::mat4 projection{ glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, farPlanes[light]) };
+
+        // Same face order and orientation as GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards
+        const glm::mat4 shadowMatrices[6]{
+            projection * glm::lookAt(position, position + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+            projection * glm::lookAt(position, position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+            projection * glm::lookAt(position, position + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+            projection * glm::lookAt(position, position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+            projection * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+            projection * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+        };
+        for (int face{ 0 }; face < 6; ++face)
+            depthShader.setMat4("shadowMatrices[" + std::to_string(face) + "]", shadowMatrices[face]);
+
+        depthShader.setInt("lightIndex", static_cast<int>(light));
+        depthShader.setVec3("lightPos", position);
+        depthShader.setFloat("farPlane", farPlanes[light]);
+
+        drawScene(depthShader);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void HybridShadows::classify(unsigned int shadowArray, unsigned int rayCountArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+    unsigned int lightIndex, const glm::vec3& lightPosition, float lightRadius, float farPlane, float minBlockerDistance,
+    const Utility::ScreenRect& rect) {
+    // No groups, one per dimension after that, no pixels
+    const uint32_t header[4]{ 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (rect.empty())
+        return;
+
+    classifyShader.use();
+    classifyShader.setInt("lightIndex", static_cast<int>(lightIndex));
+    classifyShader.setVec3("lightPos", lightPosition);
+    classifyShader.setFloat("lightRadius", lightRadius);
+    classifyShader.setFloat("farPlane", farPlane);
+    classifyShader.setFloat("minBlockerDistance", minBlockerDistance);
+    classifyShader.setIVec2("rectMin", rect.min);
+    classifyShader.setIVec2("rectMax", rect.max);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE0 + SHADOW_CUBES_UNIT);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, shadowCubes);
+
+    glBindImageTexture(0, shadowArray, 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_R16F);
+    glBindImageTexture(1, rayCountArray, 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_R8);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, pixelListSSBO);
+
+    const glm::ivec2 size{ rect.size() };
+    classifyShader.dispatch((size.x + 16 - 1) / 16, (size.y + 16 - 1) / 16);
+
+    // The ray tracer reads the list, and the GPU the dispatch arguments in it
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+uint32_t HybridShadows::readPixelCount() const {
+    uint32_t count{ 0 };
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(uint32_t), sizeof(count), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
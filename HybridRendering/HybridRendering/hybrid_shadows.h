@@ -0,0 +1,75 @@
+#ifndef HYBRID_SHADOWS_H
+#define HYBRID_SHADOWS_H
+
+#include <functional>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "utility.h"
+
+/*
+	The rasterized half of hybrid shadows. Every light gets a cube shadow map, and
+	shadow_classify.comp uses it to sort a light's pixels before any ray is traced:
+
+		no blockers around the pixel's direction    ==> lit
+		PCSS filter blocked by blockers at similar
+		distances                                    ==> umbra
+		anything else: penumbrae, depth jumps between
+		blockers, receivers cutting through the light ==> uncertain
+
+	Lit and umbra pixels get their shadow right there. Uncertain ones, and their neighbours,
+	are appended to a compacted pixel list which also holds the indirect dispatch arguments,
+	so ray_trace.comp only runs one invocation per listed pixel.
+
+	Blocker search and filter follow "Percentage-Closer Soft Shadows" (Fernando 2005), with
+	Vogel disk taps on the plane around the light-to-pixel direction.
+*/
+class HybridShadows {
+public:
+	HybridShadows(unsigned int width, unsigned int height, unsigned int lights);
+	~HybridShadows();
+
+	HybridShadows(const HybridShadows&) = delete;
+	HybridShadows& operator=(const HybridShadows&) = delete;
+
+	// Resolution of a cube face
+	static constexpr int SHADOW_MAP_SIZE{ 1024 };
+
+	// Renders the cube shadow map of every light. drawScene has to draw everything that casts
+	// shadows, setting the "model" uniform of the shader it's given. farPlanes are the lights'
+	// maxDistance, nothing further away can be lit by them anyway.
+	void renderShadowMaps(std::span<const glm::vec3> lightPositions, std::span<const float> farPlanes,
+		const std::function<void(const Shader&)>& drawScene);
+
+	/*
+		Classifies the pixels in rect for light lightIndex. Lit and umbra pixels are written to
+		layer of shadowArray (R16F), and 0 rays to the same layer of rayCountArray (R8). The rest
+		end up in pixelList(), for ray_trace.comp's tracePixelList mode.
+	*/
+	void classify(unsigned int shadowArray, unsigned int rayCountArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+		unsigned int lightIndex, const glm::vec3& lightPosition, float lightRadius, float farPlane, float minBlockerDistance,
+		const Utility::ScreenRect& rect);
+
+	// SSBO with the indirect dispatch arguments, the pixel count and the pixels, see TracedPixels in shadow_classify.comp
+	unsigned int pixelList() const { return pixelListSSBO; }
+
+	// Number of pixels the last classify() left for the ray tracer. Waits for the GPU.
+	uint32_t readPixelCount() const;
+
+private:
+	Shader depthShader{ "shadow_cube.vert", "shadow_cube.frag", "shadow_cube.geom" };
+	Shader classifyShader{ "shadow_classify.comp" };
+
+	unsigned int width;
+	unsigned int height;
+
+	// Depth cube map array, one cube per light
+	unsigned int shadowCubes{ 0 };
+	unsigned int shadowFBO{ 0 };
+
+	unsigned int pixelListSSBO{ 0 };
+};
+
+#endif // !HYBRID_SHADOWS_H
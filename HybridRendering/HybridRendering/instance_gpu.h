@@ -0,0 +1,41 @@
+#ifndef INSTANCE_GPU_H
+#define INSTANCE_GPU_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Set in InstanceGPU::flags when blasRoot points into the wide BLAS nodes instead of the binary ones
+inline constexpr uint32_t INSTANCE_WIDE_BLAS{ 1u << 0 };
+// Set when the mesh is convex, so a ray leaving its surface towards the outside can't hit it again
+inline constexpr uint32_t INSTANCE_CONVEX{ 1u << 1 };
+
+// One placed copy of a mesh in the scene, referenced by the leaves of the top-level BVH.
+// The ray tracer moves the ray into object space with worldToObject and then walks
+// the mesh's bottom-level BVH starting at blasRoot. For quantized meshes, worldToObject
+// goes all the way to the mesh's grid, which is the space its BLAS was built in.
+struct InstanceGPU {
+	glm::mat4 worldToObject;
+	uint32_t blasRoot;
+	uint32_t objectID;
+	uint32_t flags;
+	uint32_t padding; // pad to 16-byte multiple
+
+    InstanceGPU(
+        const glm::mat4& _worldToObject,
+        uint32_t _blasRoot,
+        uint32_t _objectID,
+        uint32_t _flags
+    )
+        : worldToObject(_worldToObject)
+        , blasRoot(_blasRoot)
+        , objectID(_objectID)
+        , flags(_flags)
+        , padding(0)
+    {
+    }
+};
+
+static_assert(sizeof(InstanceGPU) == 80, "InstanceGPU must match the std430 layout in the shaders");
+
+#endif // !INSTANCE_GPU_H
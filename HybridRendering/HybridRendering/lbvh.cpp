@@ -0,0 +1,271 @@
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+
+#include "bvh.h"
+#include "thread_pool.h"
+
+/*
+	Linear BVH builder, following "Maximizing Parallelism in the Construction of BVHs,
+	Octrees, and k-d Trees" (Karras 2012).
+
+	Node layout produced here:
+		[0, n - 1)      ==> interior nodes, 0 is the root
+		[n - 1, 2n - 1) ==> leaves, leaf i holds the i-th primitive in Morton order
+*/
+namespace BVH {
+    namespace {
+        ThreadPool& threadPool() {
+            static ThreadPool pool{};
+            return pool;
+        }
+
+        // Spreads the lower 10 bits of v out so that there are two zero bits between each of them
+        uint32_t expandBits(uint32_t v) {
+            v = (v * 0x00010001u) & 0xFF0000FFu;
+            v = (v * 0x00000101u) & 0x0F00F00Fu;
+            v = (v * 0x00000011u) & 0xC30C30C3u;
+            v = (v * 0x00000005u) & 0x49249249u;
+            return v;
+        }
+
+        uint32_t mortonCode(const glm::vec3& centroid, const AABB& centroidBounds) {
+            constexpr float scale{ static_cast<float>(1u << MORTON_BITS_PER_AXIS) - 1.0f };
+
+            const glm::vec3 extent{ glm::max(centroidBounds.max - centroidBounds.min, glm::vec3(1e-20f)) };
+            const glm::vec3 normalized{ glm::clamp((centroid - centroidBounds.min) / extent, 0.0f, 1.0f) };
+
+            const uint32_t x{ expandBits(static_cast<uint32_t>(normalized.x * scale)) };
+            const uint32_t y{ expandBits(static_cast<uint32_t>(normalized.y * scale)) };
+            const uint32_t z{ expandBits(static_cast<uint32_t>(normalized.z * scale)) };
+            return (x << 2) | (y << 1) | z;
+        }
+
+        // Splits [0, count) into one contiguous range per thread. Unlike ThreadPool's own
+        // chunking we need to know the ranges up front for the per-range radix histograms.
+        std::vector<size_t> splitRanges(size_t count, unsigned int rangeCount) {
+            std::vector<size_t> starts(rangeCount + 1);
+            for (unsigned int i{ 0 }; i <= rangeCount; ++i)
+                starts[i] = count * i / rangeCount;
+            return starts;
+        }
+
+        /*
+            Stable LSD radix sort of (code, index) pairs, 8 bits per pass. Every range counts
+            its digits in parallel, a prefix sum gives each range its output offsets, and then
+            every range scatters its elements in parallel. Keeping each range in order is what
+            makes the sort stable, which matches the GPU builder.
+        */
+        void radixSort(std::vector<uint32_t>& codes, std::vector<uint32_t>& indices) {
+            constexpr uint32_t RADIX_BITS{ 8 };
+            constexpr uint32_t RADIX_SIZE{ 1u << RADIX_BITS };
+            constexpr uint32_t KEY_BITS{ 3 * MORTON_BITS_PER_AXIS };
+
+            ThreadPool& pool{ threadPool() };
+            const unsigned int rangeCount{ pool.size() };
+            const std::vector<size_t> starts{ splitRanges(codes.size(), rangeCount) };
+
+            std::vector<uint32_t> codesOut(codes.size());
+            std::vector<uint32_t> indicesOut(indices.size());
+            std::vector<std::array<size_t, RADIX_SIZE>> offsets(rangeCount);
+
+            for (uint32_t shift{ 0 }; shift < KEY_BITS; shift += RADIX_BITS) {
+                pool.parallelFor(rangeCount, [&](size_t begin, size_t end) {
+                    for (size_t range{ begin }; range < end; ++range) {
+                        offsets[range].fill(0);
+                        for (size_t i{ starts[range] }; i < starts[range + 1]; ++i)
+                            ++offsets[range][(codes[i] >> shift) & (RADIX_SIZE - 1)];
+                    }
+                });
+
+                // Exclusive prefix sum, digit-major so that lower ranges come first within a digit
+                size_t total{ 0 };
+                for (uint32_t digit{ 0 }; digit < RADIX_SIZE; ++digit) {
+                    for (unsigned int range{ 0 }; range < rangeCount; ++range) {
+                        const size_t digitCount{ offsets[range][digit] };
+                        offsets[range][digit] = total;
+                        total += digitCount;
+                    }
+                }
+
+                pool.parallelFor(rangeCount, [&](size_t begin, size_t end) {
+                    for (size_t range{ begin }; range < end; ++range) {
+                        for (size_t i{ starts[range] }; i < starts[range + 1]; ++i) {
+                            const size_t destination{ offsets[range][(codes[i] >> shift) & (RADIX_SIZE - 1)]++ };
+                            codesOut[destination] = codes[i];
+                            indicesOut[destination] = indices[i];
+                        }
+                    }
+                });
+
+                codes.swap(codesOut);
+                indices.swap(indicesOut);
+            }
+        }
+
+        // Length of the longest common prefix of the keys at i and j, -1 if j is out of range.
+        // Duplicate codes are told apart by their position, as if it were appended to the code.
+        int commonPrefix(const std::vector<uint32_t>& codes, int i, int j) {
+            if (j < 0 || j >= static_cast<int>(codes.size()))
+                return -1;
+
+            if (codes[i] == codes[j])
+                return 32 + std::countl_zero(static_cast<uint32_t>(i ^ j));
+
+            return std::countl_zero(codes[i] ^ codes[j]);
+        }
+
+        struct Children {
+            uint32_t left;
+            uint32_t right;
+        };
+
+        // Finds the range of keys covered by interior node i and where that range splits
+        Children findChildren(const std::vector<uint32_t>& codes, int i) {
+            const int leafOffset{ static_cast<int>(codes.size()) - 1 };
+
+            // Direction of the range, towards the neighbour we share more bits with
+            const int direction{ commonPrefix(codes, i, i + 1) - commonPrefix(codes, i, i - 1) > 0 ? 1 : -1 };
+            const int minPrefix{ commonPrefix(codes, i, i - direction) };
+
+            // Upper bound for the length of the range, then binary search for the other end
+            int maxLength{ 2 };
+            while (commonPrefix(codes, i, i + maxLength * direction) > minPrefix)
+                maxLength *= 2;
+
+            int length{ 0 };
+            for (int step{ maxLength / 2 }; step >= 1; step /= 2) {
+                if (commonPrefix(codes, i, i + (length + step) * direction) > minPrefix)
+                    length += step;
+            }
+            const int j{ i + length * direction };
+
+            // Binary search for the last key that shares more than nodePrefix bits with i
+            const int nodePrefix{ commonPrefix(codes, i, j) };
+            int split{ 0 };
+            int step{ length };
+            do {
+                step = (step + 1) / 2;
+                if (commonPrefix(codes, i, i + (split + step) * direction) > nodePrefix)
+                    split += step;
+            } while (step > 1);
+            const int gamma{ i + split * direction + std::min(direction, 0) };
+
+            Children children{};
+            children.left = static_cast<uint32_t>(std::min(i, j) == gamma ? leafOffset + gamma : gamma);
+            children.right = static_cast<uint32_t>(std::max(i, j) == gamma + 1 ? leafOffset + gamma + 1 : gamma + 1);
+            return children;
+        }
+    }
+
+    std::vector<BVHNodeGPU> buildLBVH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& primitiveOrder) {
+        ThreadPool& pool{ threadPool() };
+        const size_t count{ primitiveBounds.size() };
+
+        std::vector<BVHNodeGPU> nodes{};
+        primitiveOrder.resize(count);
+        for (uint32_t i{ 0 }; i < count; ++i)
+            primitiveOrder[i] = i;
+
+        if (count == 0)
+            return nodes;
+
+        if (count == 1) {
+            nodes.emplace_back(primitiveBounds[0].min, primitiveBounds[0].max, INVALID_INDEX, 1u);
+            return nodes;
+        }
+
+        // 1. Centroid bounds, reduced per range and then combined
+        const std::vector<size_t> starts{ splitRanges(count, pool.size()) };
+        std::vector<AABB> rangeCentroidBounds(pool.size());
+        pool.parallelFor(pool.size(), [&](size_t begin, size_t end) {
+            for (size_t range{ begin }; range < end; ++range) {
+                for (size_t i{ starts[range] }; i < starts[range + 1]; ++i)
+                    rangeCentroidBounds[range].grow(primitiveBounds[i].centroid());
+            }
+        });
+
+        AABB centroidBounds{};
+        for (const AABB& bounds : rangeCentroidBounds)
+            centroidBounds.grow(bounds);
+
+        // 2. Morton codes
+        std::vector<uint32_t> codes(count);
+        pool.parallelFor(count, [&](size_t begin, size_t end) {
+            for (size_t i{ begin }; i < end; ++i)
+                codes[i] = mortonCode(primitiveBounds[i].centroid(), centroidBounds);
+        });
+
+        // 3. Sort
+        radixSort(codes, primitiveOrder);
+
+        // 4. Emit the hierarchy, every interior node only depends on the sorted codes
+        const uint32_t interiorCount{ static_cast<uint32_t>(count - 1) };
+        const uint32_t nodeCount{ static_cast<uint32_t>(2 * count - 1) };
+        std::vector<Children> children(interiorCount);
+        std::vector<uint32_t> parents(nodeCount, INVALID_INDEX);
+
+        pool.parallelFor(interiorCount, [&](size_t begin, size_t end) {
+            for (size_t i{ begin }; i < end; ++i) {
+                children[i] = findChildren(codes, static_cast<int>(i));
+                parents[children[i].left] = static_cast<uint32_t>(i);
+                parents[children[i].right] = static_cast<uint32_t>(i);
+            }
+        });
+
+        // 5. Fill in the nodes. Leaves get their bounds now, interior nodes get their left child
+        // and the skip link, which is the right sibling of the first ancestor we are the left child of.
+        nodes.resize(nodeCount, BVHNodeGPU{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, INVALID_INDEX, 0u });
+        pool.parallelFor(nodeCount, [&](size_t begin, size_t end) {
+            for (size_t i{ begin }; i < end; ++i) {
+                BVHNodeGPU& node{ nodes[i] };
+
+                if (i >= interiorCount) {
+                    const uint32_t leaf{ static_cast<uint32_t>(i - interiorCount) };
+                    node.aabbMin = primitiveBounds[primitiveOrder[leaf]].min;
+                    node.aabbMax = primitiveBounds[primitiveOrder[leaf]].max;
+                    node.primitiveInfo = (leaf << COUNT_BITS) | 1u;
+                }
+                else {
+                    node.primitiveInfo = children[i].left << COUNT_BITS;
+                }
+
+                uint32_t current{ static_cast<uint32_t>(i) };
+                while (parents[current] != INVALID_INDEX) {
+                    const Children& siblings{ children[parents[current]] };
+                    if (siblings.left == current) {
+                        node.skipIndex = siblings.right;
+                        break;
+                    }
+                    current = parents[current];
+                }
+            }
+        });
+
+        // 6. Bounds, bottom-up. Every leaf walks towards the root, and the second thread
+        // to arrive at a node is the one that merges its children (both are done by then).
+        std::unique_ptr<std::atomic<uint32_t>[]> arrivals{ new std::atomic<uint32_t>[interiorCount] };
+        for (uint32_t i{ 0 }; i < interiorCount; ++i)
+            arrivals[i].store(0, std::memory_order_relaxed);
+
+        pool.parallelFor(count, [&](size_t begin, size_t end) {
+            for (size_t leaf{ begin }; leaf < end; ++leaf) {
+                uint32_t current{ parents[interiorCount + leaf] };
+                while (current != INVALID_INDEX) {
+                    if (arrivals[current].fetch_add(1, std::memory_order_acq_rel) == 0)
+                        break;
+
+                    AABB bounds{ nodeBounds(nodes[children[current].left]) };
+                    bounds.grow(nodeBounds(nodes[children[current].right]));
+                    nodes[current].aabbMin = bounds.min;
+                    nodes[current].aabbMax = bounds.max;
+
+                    current = parents[current];
+                }
+            }
+        });
+
+        return nodes;
+    }
+}
@@ -0,0 +1,77 @@
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "light_culling.h"
+
+namespace {
+    // Texture unit light_cull.comp samples the positions from
+    constexpr int POSITION_UNIT{ 0 };
+
+    // SSBO bindings, see Lights, LightTiles and LightIndices in light_cull.comp
+    constexpr int LIGHTS_BINDING{ 13 };
+    constexpr int TILES_BINDING{ 16 };
+    constexpr int INDICES_BINDING{ 17 };
+
+    // Index and overflow counts in front of the indices, see LightIndices in light_cull.comp
+    constexpr GLsizeiptr INDEX_LIST_HEADER_SIZE{ 2 * sizeof(uint32_t) };
+}
+
+LightCulling::LightCulling(unsigned int width, unsigned int height)
+    : tilesX{ (width + TILE_SIZE - 1) / TILE_SIZE }
+    , tilesY{ (height + TILE_SIZE - 1) / TILE_SIZE }
+{
+    const GLsizeiptr tileCount{ static_cast<GLsizeiptr>(tilesX) * tilesY };
+
+    glGenBuffers(1, &tileRangeSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileRangeSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tileCount * 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+
+    // Room for every tile to be full, so a crowded tile never takes another one's lights
+    glGenBuffers(1, &lightIndexSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, INDEX_LIST_HEADER_SIZE + tileCount * MAX_LIGHTS_PER_TILE * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    cullShader.use();
+    cullShader.setInt("gPosition", POSITION_UNIT);
+
+    PLOGD << "Light culling: " << tilesX << "x" << tilesY << " tiles";
+}
+
+LightCulling::~LightCulling() {
+    glDeleteBuffers(1, &tileRangeSSBO);
+    glDeleteBuffers(1, &lightIndexSSBO);
+    glDeleteProgram(cullShader.ID);
+}
+
+void LightCulling::cull(unsigned int gPosition, unsigned int lightSSBO) {
+    // Only the counts have to start at 0, the tiles overwrite everything else
+    const uint32_t zero{ 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexSSBO);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, INDEX_LIST_HEADER_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, lightSSBO);
+    bind();
+
+    cullShader.use();
+    cullShader.dispatch(tilesX, tilesY);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightCulling::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILES_BINDING, tileRangeSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, lightIndexSSBO);
+}
+
+uint32_t LightCulling::readOverflowedTiles() const {
+    uint32_t count{ 0 };
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), sizeof(count), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
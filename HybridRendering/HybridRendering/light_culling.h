@@ -0,0 +1,64 @@
+#ifndef LIGHT_CULLING_H
+#define LIGHT_CULLING_H
+
+#include <cstdint>
+
+#include "shader.h"
+
+/*
+	Tiled light culling, so the lighting pass only loops over the lights that can reach a pixel
+	instead of every light in the scene. light_cull.comp runs one workgroup per TILE_SIZE x
+	TILE_SIZE tile of the screen:
+
+		gPosition    ==> world space box around the tile's pixels
+		lights       ==> the ones whose MaxDistance sphere touches that box
+		tile ranges  ==> where the tile's lights start in the index list, and how many there are
+
+	The box follows the depth range of the tile's own surfaces, like clustered shading's depth
+	bounds, only tighter. Tiles on a depth edge get a long box and more lights, which is still
+	correct, just slower. A tile that ends up with more than MAX_LIGHTS_PER_TILE keeps none,
+	and the lighting pass shades it with every light instead.
+
+	deferred_shading.frag then reads the tile ranges at binding 16 and the index list at
+	binding 17, see LightTiles and LightIndices in there.
+*/
+class LightCulling {
+public:
+	LightCulling(unsigned int width, unsigned int height);
+	~LightCulling();
+
+	LightCulling(const LightCulling&) = delete;
+	LightCulling& operator=(const LightCulling&) = delete;
+
+	// Pixels along a tile's edge, the workgroup size of light_cull.comp
+	static constexpr unsigned int TILE_SIZE{ 16 };
+
+	// Lights a single tile can list. Has to match light_cull.comp.
+	static constexpr unsigned int MAX_LIGHTS_PER_TILE{ 256 };
+
+	// Count of a tile with more lights than that, see LightTiles in deferred_shading.frag
+	static constexpr uint32_t TOO_MANY_LIGHTS{ 0xFFFFFFFFu };
+
+	// Bins the lights in lightSSBO, a LightGPU each, see light_gpu.h, into the screen's tiles
+	void cull(unsigned int gPosition, unsigned int lightSSBO);
+
+	// Binds the tile ranges and the index list for the lighting pass
+	void bind() const;
+
+	// Number of tiles the last cull() found too many lights for. Waits for the GPU.
+	uint32_t readOverflowedTiles() const;
+
+private:
+	Shader cullShader{ "light_cull.comp" };
+
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	// An offset and a count per tile, row by row
+	unsigned int tileRangeSSBO{ 0 };
+
+	// Number of indices used and of tiles that overflowed, then the indices of every tile one after the other
+	unsigned int lightIndexSSBO{ 0 };
+};
+
+#endif // !LIGHT_CULLING_H
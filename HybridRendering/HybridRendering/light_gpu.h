@@ -0,0 +1,38 @@
+#ifndef LIGHT_GPU_H
+#define LIGHT_GPU_H
+
+#include <glm/glm.hpp>
+
+// One light in the lights SSBO, the same values the shaders otherwise get through the Light
+// uniform struct. Lets a single dispatch loop over every light, see batchLights in ray_trace.comp.
+struct LightGPU {
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+	float maxDistance;
+	float linear;
+	float quadratic;
+	float padding[2]; // pad to 16-byte multiple
+
+    LightGPU(
+        const glm::vec3& _position,
+        float _radius,
+        const glm::vec3& _color,
+        float _maxDistance,
+        float _linear,
+        float _quadratic
+    )
+        : position(_position)
+        , radius(_radius)
+        , color(_color)
+        , maxDistance(_maxDistance)
+        , linear(_linear)
+        , quadratic(_quadratic)
+        , padding{ 0.0f, 0.0f }
+    {
+    }
+};
+
+static_assert(sizeof(LightGPU) == 48, "LightGPU must match the std430 layout in the shaders");
+
+#endif // !LIGHT_GPU_H
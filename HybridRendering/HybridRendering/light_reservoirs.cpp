@@ -0,0 +1,117 @@
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "light_reservoirs.h"
+
+namespace {
+    // Texture units restir_sample.comp and restir_spatial.comp sample from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+    constexpr int ALBEDO_SPEC_UNIT{ 2 };
+    constexpr int PREVIOUS_POSITION_UNIT{ 3 };
+    constexpr int PREVIOUS_NORMAL_UNIT{ 4 };
+
+    // SSBO bindings, see Lights, Reservoirs and CandidateReservoirs in the shaders
+    constexpr int LIGHTS_BINDING{ 13 };
+    constexpr int RESERVOIRS_BINDING{ 14 };
+    constexpr int CANDIDATES_BINDING{ 15 };
+
+    // light, weightSum, M and W
+    constexpr GLsizeiptr RESERVOIR_SIZE{ 4 * sizeof(uint32_t) };
+}
+
+LightReservoirs::LightReservoirs(unsigned int width, unsigned int height)
+    : width{ width }
+    , height{ height }
+{
+    // Zeroed, so that the first frame has a history without any weight
+    glGenBuffers(2, reservoirSSBOs);
+    for (unsigned int buffer : reservoirSSBOs) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, RESERVOIR_SIZE * width * height, nullptr, GL_DYNAMIC_COPY);
+
+        const uint32_t zero{ 0 };
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    for (unsigned int* texture : { &previousPosition, &previousNormal }) {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_2D, *texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    sampleShader.use();
+    sampleShader.setInt("gPosition", POSITION_UNIT);
+    sampleShader.setInt("gNormal", NORMAL_UNIT);
+    sampleShader.setInt("gAlbedoSpec", ALBEDO_SPEC_UNIT);
+    sampleShader.setInt("previousPosition", PREVIOUS_POSITION_UNIT);
+    sampleShader.setInt("previousNormal", PREVIOUS_NORMAL_UNIT);
+
+    spatialShader.use();
+    spatialShader.setInt("gPosition", POSITION_UNIT);
+    spatialShader.setInt("gNormal", NORMAL_UNIT);
+    spatialShader.setInt("gAlbedoSpec", ALBEDO_SPEC_UNIT);
+
+    PLOGD << "Light reservoirs: " << width << "x" << height;
+}
+
+LightReservoirs::~LightReservoirs() {
+    glDeleteBuffers(2, reservoirSSBOs);
+    glDeleteTextures(1, &previousPosition);
+    glDeleteTextures(1, &previousNormal);
+    glDeleteProgram(sampleShader.ID);
+    glDeleteProgram(spatialShader.ID);
+}
+
+void LightReservoirs::resample(unsigned int gPosition, unsigned int gNormal, unsigned int gAlbedoSpec, unsigned int lightSSBO,
+    const glm::vec3& viewPos, unsigned int frameIndex, const Parameters& parameters) {
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE0 + ALBEDO_SPEC_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glActiveTexture(GL_TEXTURE0 + PREVIOUS_POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, previousPosition);
+    glActiveTexture(GL_TEXTURE0 + PREVIOUS_NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, previousNormal);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, lightSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RESERVOIRS_BINDING, reservoirSSBOs[1]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CANDIDATES_BINDING, reservoirSSBOs[0]);
+
+    // Candidates, and last frame's reservoirs in [1]
+    sampleShader.use();
+    sampleShader.setVec3("viewPos", viewPos);
+    sampleShader.setUInt("frameIndex", frameIndex);
+    sampleShader.setInt("candidateCount", parameters.candidates);
+    sampleShader.setMat4("previousViewProjection", previousViewProjection);
+    sampleShader.setBool("temporalReuse", parameters.temporalReuse && historyValid);
+    sampleShader.dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Neighbours, from [0] back into [1]
+    spatialShader.use();
+    spatialShader.setVec3("viewPos", viewPos);
+    spatialShader.setUInt("frameIndex", frameIndex);
+    spatialShader.setInt("spatialSamples", parameters.spatialSamples);
+    spatialShader.setFloat("spatialRadius", parameters.spatialRadius);
+    spatialShader.dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightReservoirs::endFrame(const glm::mat4& viewProjection, unsigned int gPosition, unsigned int gNormal) {
+    glCopyImageSubData(gPosition, GL_TEXTURE_2D, 0, 0, 0, 0, previousPosition, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+    glCopyImageSubData(gNormal, GL_TEXTURE_2D, 0, 0, 0, 0, previousNormal, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+
+    previousViewProjection = viewProjection;
+    historyValid = true;
+}
+
+void LightReservoirs::reset() {
+    historyValid = false;
+}
@@ -0,0 +1,72 @@
+#ifndef LIGHT_RESERVOIRS_H
+#define LIGHT_RESERVOIRS_H
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+/*
+	Picks one light per pixel out of many with spatiotemporal reservoir resampling, ReSTIR
+	("Spatiotemporal reservoir resampling for real-time ray tracing with dynamic direct
+	lighting", Bitterli et al. 2020). The ray tracer then only traces the picked light, so
+	the number of shadow rays stays the same however many lights there are.
+
+		restir_sample.comp     ==> a few random lights per pixel, weighted by their unshadowed
+		                           contribution, merged with the pixel's reservoir of last frame
+		restir_spatial.comp    ==> merged with the reservoirs of a few neighbours
+		ray_trace.comp         ==> traces the picked light, scaling its weight by how visible it is
+		deferred_shading.frag  ==> shades the picked light with the reservoir's weight
+
+	A pixel's reservoir is the light it picked and the weight W that turns that one light's
+	contribution into an estimate of all of them, see Reservoir in restir_sample.comp. Since
+	occluded lights get no weight, the next frame's reservoirs mostly pick lights that reach
+	the pixel. Neighbours are merged without MIS weights, which is the paper's biased variant.
+*/
+class LightReservoirs {
+public:
+	LightReservoirs(unsigned int width, unsigned int height);
+	~LightReservoirs();
+
+	LightReservoirs(const LightReservoirs&) = delete;
+	LightReservoirs& operator=(const LightReservoirs&) = delete;
+
+	struct Parameters {
+		int candidates; // random lights each pixel looks at per frame
+		bool temporalReuse;
+		int spatialSamples; // neighbours merged with each pixel
+		float spatialRadius; // in pixels
+	};
+
+	// Fills reservoirs() for this frame. lightSSBO holds a LightGPU per light, see light_gpu.h.
+	void resample(unsigned int gPosition, unsigned int gNormal, unsigned int gAlbedoSpec, unsigned int lightSSBO,
+		const glm::vec3& viewPos, unsigned int frameIndex, const Parameters& parameters);
+
+	// SSBO with a reservoir per pixel, row by row. The ray tracer and the lighting pass read it
+	// at binding 14, and it's next frame's history.
+	unsigned int reservoirs() const { return reservoirSSBOs[1]; }
+
+	// Keeps this frame's camera and G-buffer for the next frame's reprojection
+	void endFrame(const glm::mat4& viewProjection, unsigned int gPosition, unsigned int gNormal);
+
+	// Forgets the history, e.g. after the lights changed completely
+	void reset();
+
+private:
+	Shader sampleShader{ "restir_sample.comp" };
+	Shader spatialShader{ "restir_spatial.comp" };
+
+	unsigned int width;
+	unsigned int height;
+
+	// [0] is written by restir_sample.comp and read by restir_spatial.comp, which writes [1]
+	unsigned int reservoirSSBOs[2]{ 0, 0 };
+
+	unsigned int previousPosition{ 0 };
+	unsigned int previousNormal{ 0 };
+	glm::mat4 previousViewProjection{ 1.0f };
+
+	// False until a whole frame has been resampled
+	bool historyValid{ false };
+};
+
+#endif // !LIGHT_RESERVOIRS_H
@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "bvh.h"
+#include "light_triangles.h"
+
+namespace {
+    constexpr unsigned int TRIANGLE_BINDING{ 19 };
+    constexpr unsigned int RANGE_BINDING{ 20 };
+    constexpr unsigned int OBJECT_BINDING{ 21 };
+
+    // Whether the sphere touches the box, by the distance to the box's closest point
+    bool sphereTouchesBox(const glm::vec3& center, float radius, const BVH::AABB& box) {
+        const glm::vec3 closest{ glm::clamp(center, box.min, box.max) };
+        const glm::vec3 offset{ center - closest };
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    // The storage only grows, so a frame with the same lists just updates them. Room for at least
+    // one element, since a buffer without storage can't back a shader's array.
+    template <typename T>
+    void uploadArray(unsigned int ssbo, size_t& capacity, const std::vector<T>& data) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        if (data.size() > capacity || capacity == 0) {
+            capacity = std::max<size_t>(data.size(), 1);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        }
+        if (!data.empty())
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(T), data.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+}
+
+LightTriangles::LightTriangles(unsigned int lights)
+    : ranges(lights, glm::uvec2{ 0, TOO_MANY_TRIANGLES })
+{
+    glGenBuffers(1, &triangleSSBO);
+    glGenBuffers(1, &rangeSSBO);
+    glGenBuffers(1, &objectSSBO);
+
+    // Until the first build() every light goes through the acceleration structure
+    uploadArray(triangleSSBO, triangleCapacity, triangles);
+    uploadArray(rangeSSBO, rangeCapacity, ranges);
+    uploadArray(objectSSBO, objectCapacity, lightObjects);
+
+    PLOGD << "Light triangle lists: " << lights << " lights, up to " << MAX_TRIANGLES_PER_LIGHT << " triangles each";
+}
+
+LightTriangles::~LightTriangles() {
+    glDeleteBuffers(1, &triangleSSBO);
+    glDeleteBuffers(1, &rangeSSBO);
+    glDeleteBuffers(1, &objectSSBO);
+}
+
+void LightTriangles::build(std::span<const TriangleGPU> sceneTriangles, std::span<const Object> objects, std::span<const glm::vec3> lightPositions,
+    std::span<const float> maxDistances, float lightRadius) {
+    triangles.clear();
+    lightObjects.clear();
+    overflowed = 0;
+
+    std::vector<BVH::AABB> bounds{};
+    bounds.reserve(sceneTriangles.size());
+    for (const TriangleGPU& triangle : sceneTriangles)
+        bounds.push_back(BVH::triangleBounds(triangle));
+
+    for (size_t light{ 0 }; light < lightPositions.size() && light < ranges.size(); ++light) {
+        const size_t firstTriangle{ triangles.size() };
+        const size_t firstObject{ lightObjects.size() };
+        const float reach{ maxDistances[light] + lightRadius };
+
+        for (const Object& object : objects) {
+            const size_t objectFirstTriangle{ triangles.size() };
+            BVH::AABB objectBounds{};
+            for (uint32_t i{ object.firstTriangle }; i < object.firstTriangle + object.triangleCount; ++i) {
+                if (!sphereTouchesBox(lightPositions[light], reach, bounds[i]))
+                    continue;
+                triangles.emplace_back(sceneTriangles[i]);
+                objectBounds.grow(bounds[i]);
+            }
+
+            // Only the part of the object the light reaches
+            const size_t objectTriangles{ triangles.size() - objectFirstTriangle };
+            if (objectTriangles > 0) {
+                lightObjects.push_back(ObjectGPU{ objectBounds.min, static_cast<uint32_t>(objectFirstTriangle), objectBounds.max,
+                    static_cast<uint32_t>(objectTriangles), object.objectID, object.flags, { 0, 0 } });
+            }
+
+            if (triangles.size() - firstTriangle > MAX_TRIANGLES_PER_LIGHT)
+                break;
+        }
+
+        if (triangles.size() - firstTriangle > MAX_TRIANGLES_PER_LIGHT) {
+            triangles.resize(firstTriangle);
+            lightObjects.resize(firstObject);
+            ranges[light] = glm::uvec2{ 0, TOO_MANY_TRIANGLES };
+            ++overflowed;
+        }
+        else
+            ranges[light] = glm::uvec2{ static_cast<uint32_t>(firstObject), static_cast<uint32_t>(lightObjects.size() - firstObject) };
+    }
+
+    uploadArray(triangleSSBO, triangleCapacity, triangles);
+    uploadArray(rangeSSBO, rangeCapacity, ranges);
+    uploadArray(objectSSBO, objectCapacity, lightObjects);
+}
+
+void LightTriangles::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRIANGLE_BINDING, triangleSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RANGE_BINDING, rangeSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectSSBO);
+}
@@ -0,0 +1,105 @@
+#ifndef LIGHT_TRIANGLES_H
+#define LIGHT_TRIANGLES_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "triangle_gpu.h"
+
+/*
+	Per light, the world space triangles that can block a shadow ray to it. A ray only runs
+	from a pixel within MaxDistance of its point on the light, so everything it passes lies
+	within MaxDistance + Radius of the light's center. Triangles whose box doesn't touch that
+	sphere are dropped, and the rest are copied into one buffer, light after light.
+
+	The triangles stay grouped by the object they belong to. main.cpp hands over an object
+	table, a range of the scene's triangles per object, and every light gets its own copy of
+	the objects it reaches, with the bounds of just their listed triangles:
+
+		ray misses the object's box                      ==> none of its triangles are tested
+		ray leaves the surface of the convex object it
+		starts on                                        ==> can't hit that object again
+
+	A small local light then only has the handful of triangles around it, which ray_trace.comp
+	simply tests one object after the other instead of walking the acceleration structure.
+	Lights with more than MAX_TRIANGLES_PER_LIGHT are left to the acceleration structure, which
+	is the better deal by then.
+
+	Built on the CPU from the triangles the scene already has in main.cpp, again on every frame
+	that traces shadows or moves the crates.
+
+	SSBO bindings used by ray_trace.comp:
+		19 ==> a TriangleEdgesGPU per listed triangle, in world space
+		20 ==> per light, where its objects start and how many there are, see TOO_MANY_TRIANGLES
+		21 ==> an ObjectGPU per listed object, with its range of the listed triangles
+*/
+class LightTriangles {
+public:
+	explicit LightTriangles(unsigned int lights);
+	~LightTriangles();
+
+	LightTriangles(const LightTriangles&) = delete;
+	LightTriangles& operator=(const LightTriangles&) = delete;
+
+	// Lights with more than this go through the acceleration structure
+	static constexpr uint32_t MAX_TRIANGLES_PER_LIGHT{ 128 };
+
+	// Count of a light whose list was too long and which goes through the acceleration structure instead
+	static constexpr uint32_t TOO_MANY_TRIANGLES{ 0xFFFFFFFFu };
+
+	// Set in the flags of an object no ray leaving its surface towards the outside can hit again
+	static constexpr uint32_t CONVEX{ 1u << 0 };
+
+	// A range of the scene's triangles, and the object ID the G-buffer has for them
+	struct Object {
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		uint32_t objectID;
+		uint32_t flags;
+	};
+
+	// An object as one light sees it. Each vec3 is followed by a uint to line up with the std430 layout in ray_trace.comp.
+	struct ObjectGPU {
+		glm::vec3 boundsMin;
+		uint32_t firstTriangle;
+		glm::vec3 boundsMax;
+		uint32_t triangleCount;
+		uint32_t objectID;
+		uint32_t flags;
+		uint32_t padding[2]; // pad to 16-byte multiple
+	};
+
+	// Lists the objects of sceneTriangles, in world space, whose triangles can block each light's shadow rays
+	void build(std::span<const TriangleGPU> sceneTriangles, std::span<const Object> objects, std::span<const glm::vec3> lightPositions,
+		std::span<const float> maxDistances, float lightRadius);
+
+	// Binds the triangles, ranges and objects to the bindings listed above
+	void bind() const;
+
+	// Triangles and objects listed over all lights, and lights that overflowed, for the UI
+	uint32_t listedTriangles() const { return static_cast<uint32_t>(triangles.size()); }
+	uint32_t listedObjects() const { return static_cast<uint32_t>(lightObjects.size()); }
+	uint32_t overflowedLights() const { return overflowed; }
+
+private:
+	std::vector<TriangleEdgesGPU> triangles{};
+	std::vector<ObjectGPU> lightObjects{};
+	std::vector<glm::uvec2> ranges{};
+	uint32_t overflowed{ 0 };
+
+	unsigned int triangleSSBO{ 0 };
+	unsigned int rangeSSBO{ 0 };
+	unsigned int objectSSBO{ 0 };
+
+	// Elements each buffer has room for
+	size_t triangleCapacity{ 0 };
+	size_t rangeCapacity{ 0 };
+	size_t objectCapacity{ 0 };
+};
+
+static_assert(sizeof(LightTriangles::ObjectGPU) == 48, "ObjectGPU must match the std430 layout in ray_trace.comp");
+
+#endif // !LIGHT_TRIANGLES_H
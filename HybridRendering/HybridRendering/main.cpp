@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <array>
 #include <iostream>
+#include <random>
 #include <string_view>
 
 #include <glad/glad.h>
@@ -24,7 +26,19 @@
 #include "shader.h"
 #include "settings.h"
 #include "utility.h"
-#include "triangle_gpu.h"
+#include "acceleration_structure.h"
+#include "blue_noise.h"
+#include "hybrid_shadows.h"
+#include "light_culling.h"
+#include "light_gpu.h"
+#include "light_reservoirs.h"
+#include "light_triangles.h"
+#include "shadow_cache.h"
+#include "shadow_denoiser.h"
+#include "shadow_invalidation.h"
+#include "shadow_temporal_filter.h"
+#include "shadow_tile_classifier.h"
+#include "shadow_upsampler.h"
 
 // forward declarations
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -34,6 +48,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 bool firstMouse{ true };
 bool firstRenderPass{ true };
 Settings::RenderSettings renderSettings{};
+Settings::RenderStats renderStats{};
 
 // timing
 float deltaTime{ 0.0f };
@@ -78,7 +93,6 @@ int main() {
     Shader shaderGeometryPass{ "gbuffer.vert", "gbuffer.frag" };
     Shader shaderLightingPass{ "deferred_shading.vert", "deferred_shading.frag" };
     Shader shaderLightBox{ "deferred_light.vert", "deferred_light.frag" };
-    Shader rayTraceShader{ "ray_trace.comp" };
 
     // Object positions
     std::vector<glm::vec3> objectPositions{};
@@ -109,53 +123,50 @@ int main() {
     floorModel = glm::scale(floorModel, glm::vec3(5.0f));
     
 
-    // Contains the triangles in the scene that will get passed to the GPU in an SSBO
-    std::vector<TriangleGPU> gpuTriangles{};
+    // Build the acceleration structure that the ray tracer uses to find shadow casters.
+    // Each mesh is stored once in object space, and every object in the scene is an instance of it.
+    // Large scenes that need to load quickly can use BVH::BuildMode::lbvh instead, at the cost of a slightly worse tree.
+    // The BLAS layout can be switched to BVH::NodeLayout::bvh4 or bvh8 to trade a few extra box tests for far fewer
+    // node bytes per ray, compare them with "Collect Traversal Stats".
+    // TriangleLayout::indexed shares vertices between triangles, which takes far less memory on big meshes
+    // but costs a few more fetches per triangle test. TriangleLayout::quantized snaps every mesh to a 16-bit grid
+    // over its bounds, which is the smallest of all and has the ray tracer read 20 bytes per test instead of 48.
+    constexpr BVH::NodeLayout blasLayout{ BVH::NodeLayout::binary };
+    constexpr TriangleLayout triangleLayout{ TriangleLayout::edges };
+    AccelerationStructure accelerationStructure{ BVH::BuildMode::sah, blasLayout, triangleLayout };
+    renderStats.blasLayout = BVH::nodeLayoutName(blasLayout);
+    renderStats.triangleLayout = triangleLayoutName(triangleLayout);
+    const std::vector<TriangleGPU> cubeTriangles{ Utility::createTriangles(Utility::cubeVertices, nextID) };
+    const uint32_t cubeMesh{ accelerationStructure.addMesh(cubeTriangles, true) };
+    const std::vector<TriangleGPU> floorTriangles{ Utility::createTriangles(Utility::floorVertices, nextID) };
+    const uint32_t floorMesh{ accelerationStructure.addMesh(floorTriangles, true) };
+
+    // The same crate again, but as a dynamic mesh whose BLAS is built on the GPU straight from an SSBO.
+    // This is the path geometry that changes every frame would take, see "Build Crate BLAS on GPU".
+    unsigned int cubeTriangleSSBO{};
+    glGenBuffers(1, &cubeTriangleSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cubeTriangleSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, cubeTriangles.size() * sizeof(TriangleGPU), cubeTriangles.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    BVH::AABB cubeBounds{};
+    for (const TriangleGPU& triangle : cubeTriangles)
+        cubeBounds.grow(BVH::triangleBounds(triangle));
+    const uint32_t gpuCubeMesh{ accelerationStructure.addDynamicMesh(static_cast<uint32_t>(cubeTriangles.size()), cubeBounds, true) };
 
-    // Populating the gpuTriangles vector
+    // Remember which instance belongs to which box so we can move them later
+    std::vector<uint32_t> objectInstances{};
     for (unsigned int i{ 0 }; i < objectPositions.size(); ++i)
-    {
-        glm::mat4 normalModel{ glm::transpose(glm::inverse(glm::mat3(objectTransforms[i]))) };
-
-        // Since each point has 8 elements and we want 3 points per triangle
-        for (unsigned int j{ 0 }; j < Utility::cubeVertices.size(); j += (8 * 3)) {
-            gpuTriangles.emplace_back(
-                objectTransforms[i] * glm::vec4{ Utility::cubeVertices[j], Utility::cubeVertices[j + 1], Utility::cubeVertices[j + 2], 1.0f },
-                objectTransforms[i] * glm::vec4{ Utility::cubeVertices[j + 8], Utility::cubeVertices[j + 9], Utility::cubeVertices[j + 10], 1.0f },
-                objectTransforms[i] * glm::vec4{ Utility::cubeVertices[j + 16], Utility::cubeVertices[j + 17], Utility::cubeVertices[j + 18], 1.0f },
-                glm::normalize(normalModel * glm::vec4{ Utility::cubeVertices[j + 19], Utility::cubeVertices[j + 20], Utility::cubeVertices[j + 21], 0.0f }), // normal
-                nextID++
-            );
-        }
-    }
+        objectInstances.push_back(accelerationStructure.addInstance(cubeMesh, objectTransforms[i], i));
+    const uint32_t floorInstance{ accelerationStructure.addInstance(floorMesh, floorModel, static_cast<uint32_t>(objectPositions.size())) };
 
-    glm::mat4 floorNormalModel{ glm::transpose(glm::inverse(glm::mat3(floorModel))) };
-
-    // Since each point has 8 elements and we want 3 points per triangle
-    for (unsigned int j{ 0 }; j < Utility::floorVertices.size(); j += (8 * 3)) {
-        gpuTriangles.emplace_back(
-            floorModel * glm::vec4{ Utility::floorVertices[j], Utility::floorVertices[j + 1], Utility::floorVertices[j + 2], 1.0f },
-            floorModel * glm::vec4{ Utility::floorVertices[j + 8], Utility::floorVertices[j + 9], Utility::floorVertices[j + 10], 1.0f },
-            floorModel * glm::vec4{ Utility::floorVertices[j + 16], Utility::floorVertices[j + 17], Utility::floorVertices[j + 18], 1.0f },
-            glm::normalize(floorNormalModel * glm::vec4{ Utility::floorVertices[j + 19], Utility::floorVertices[j + 20], Utility::floorVertices[j + 21], 0.0f }), // normal
-            nextID++
-        );
-    }
+    accelerationStructure.build();
 
-    /*for (const TriangleGPU& triangle : gpuTriangles) {
-        PLOGD << "TRIANGLE:";
-        PLOGD << "v0: " << glm::to_string(triangle.v0);
-        PLOGD << "v1: " << glm::to_string(triangle.v1);
-        PLOGD << "v2: " << glm::to_string(triangle.v2);
-        PLOGD << "normal: " << glm::to_string(triangle.normal);
-    }*/
-
-    // Set up triangle SSBO
-    unsigned int triangleSSBO{};
-    glGenBuffers(1, &triangleSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, triangleSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, gpuTriangles.size() * sizeof(TriangleGPU), gpuTriangles.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    // Build the GPU crate once up front and make sure it agrees with the CPU builder
+    const uint32_t cubeTriangleCount{ static_cast<uint32_t>(cubeTriangles.size()) };
+    accelerationStructure.rebuildDynamicMesh(gpuCubeMesh, cubeTriangleSSBO, cubeTriangleCount);
+    if (!accelerationStructure.validateDynamicMesh(gpuCubeMesh, cubeTriangleSSBO, cubeTriangleCount))
+        PLOGE << "GPU BVH builder produced a broken BLAS";
 
     // load textures
     unsigned int crateDiffuseMap{ Utility::loadTexture("resources/textures/container2.png", GL_TEXTURE0) };
@@ -163,9 +174,16 @@ int main() {
     unsigned int floorDiffuseMap{ Utility::loadTexture("resources/textures/floor.jpg", GL_TEXTURE2) };
     unsigned int floorSpecularMap{ Utility::loadTexture("resources/textures/floor_specular.jpg", GL_TEXTURE3) };
 
+    // The ray tracer is compiled for the BLAS layout the acceleration structure was built with
+    Shader rayTraceShader{ "ray_trace.comp", accelerationStructure.shaderDefines() };
     rayTraceShader.use();
     rayTraceShader.setInt("gPosition", 0);
     rayTraceShader.setInt("gNormal", 1);
+    rayTraceShader.setInt("blueNoise", 2);
+    rayTraceShader.setInt("gObjectID", 3);
+
+    // Per pixel offsets for the blue noise shadow sampler
+    unsigned int blueNoiseTexture{ BlueNoise::createTexture() };
 
     shaderGeometryPass.use();
     shaderGeometryPass.setInt("texture_diffuse1", 0);
@@ -176,8 +194,8 @@ int main() {
     glGenFramebuffers(1, &gBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 
-    // G-Buffer keeps track of positions, normals, albedo, and specular intensity
-    unsigned int gPosition{}, gNormal{}, gAlbedoSpec{};
+    // G-Buffer keeps track of positions, normals, albedo, specular intensity and which object is where
+    unsigned int gPosition{}, gNormal{}, gAlbedoSpec{}, gObjectID{};
 
     // Position color buffer
     glGenTextures(1, &gPosition);
@@ -203,11 +221,19 @@ int main() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
 
-    // All 3 should be color attachments
-    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    // Object ID buffer, the same ids the acceleration structure uses
+    glGenTextures(1, &gObjectID);
+    glBindTexture(GL_TEXTURE_2D, gObjectID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, Constants::SCR_WIDTH, Constants::SCR_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, gObjectID, 0);
+
+    // All 4 should be color attachments
+    unsigned int attachments[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
     
-    // Output from our fragment shader will be written into the 3 buffers
-    glDrawBuffers(3, attachments);
+    // Output from our fragment shader will be written into the 4 buffers
+    glDrawBuffers(4, attachments);
 
     // create and attach depth buffer (renderbuffer)
     unsigned int rboDepth{};
@@ -230,6 +256,53 @@ int main() {
     glBindTexture(GL_TEXTURE_2D_ARRAY, gRayTracedShadowsArray);
     glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16F, Constants::SCR_WIDTH, Constants::SCR_HEIGHT, Constants::NR_LIGHTS);
 
+    // How many of the shadow samples each pixel actually traced, relative to the full budget
+    GLuint gShadowRayCountArray;
+    glGenTextures(1, &gShadowRayCountArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, gShadowRayCountArray);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8, Constants::SCR_WIDTH, Constants::SCR_HEIGHT, Constants::NR_LIGHTS);
+
+    // Fills in the pixels the ray tracer skips at lower shadow resolutions
+    ShadowUpsampler shadowUpsampler{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+
+    // Rasterized cube shadow maps that decide which pixels need rays at all
+    HybridShadows hybridShadows{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT, Constants::NR_LIGHTS };
+
+    // Or whole tiles, by whether anything is in the way of them and the light at all
+    ShadowTileClassifier shadowTileClassifier{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+
+    // Everything that casts shadows, same as what the acceleration structure holds
+    const auto drawShadowCasters{ [&](const Shader& shader) {
+        for (const glm::mat4& transform : objectTransforms) {
+            shader.setMat4("model", transform);
+            Utility::renderCube();
+        }
+
+        shader.setMat4("model", floorModel);
+        Utility::renderFloor();
+    } };
+
+    // Keeps the shadows of past frames around, so the ray tracer only needs a couple of samples per frame
+    ShadowTemporalFilter shadowTemporalFilter{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT, Constants::NR_LIGHTS };
+
+    // And blurs what's left of the noise without crossing edges
+    ShadowDenoiser shadowDenoiser{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+
+    // Remembers what each light's shadow was traced with, so unchanged ones aren't traced again
+    ShadowCache shadowCache{ Constants::NR_LIGHTS };
+
+    // And when only objects moved, traces just the tiles they can have changed
+    ShadowInvalidation shadowInvalidation{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT, Constants::NR_LIGHTS };
+
+    // The few triangles around each light, which the ray tracer can test without the acceleration structure
+    LightTriangles lightTriangles{ Constants::NR_LIGHTS };
+
+    // Picks one light per pixel to trace, for when there are too many to trace them all
+    LightReservoirs lightReservoirs{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+
+    // Bins the lights into screen tiles, so the lighting pass only shades the ones that reach a pixel
+    LightCulling lightCulling{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+
     // setting up the lights
     std::vector<glm::vec3> lightPositions{};
     std::vector<glm::vec3> lightColors{};
@@ -256,11 +329,56 @@ int main() {
     lightPositions.emplace_back(0.0f, 0.05f, 2.0f);
     lightColors.emplace_back(0.0f, 1.0f, 0.45f);
 
+    // Small unshadowed lights scattered over the floor, see "Fill Lights". They're dim and fall
+    // off quickly, so each one only reaches a couple of units and a handful of tiles.
+    std::vector<LightGPU> fillLights{};
+    std::mt19937 fillLightRandom{ 13 };
+    std::uniform_real_distribution<float> floorCoordinate{ -5.0f, 5.0f };
+    std::uniform_real_distribution<float> fillLightHeight{ -1.3f, 0.0f };
+    std::uniform_real_distribution<float> fillLightChannel{ 0.05f, 0.15f };
+    for (unsigned int i{ 0 }; i < Constants::MAX_FILL_LIGHTS; ++i) {
+        const glm::vec3 position{ floorCoordinate(fillLightRandom), fillLightHeight(fillLightRandom), floorCoordinate(fillLightRandom) };
+        const glm::vec3 color{ fillLightChannel(fillLightRandom), fillLightChannel(fillLightRandom), fillLightChannel(fillLightRandom) };
+
+        const float constant{ 1.0f };
+        const float linear{ 0.7f };
+        const float quadratic{ 1.8f };
+        const float maxBrightness = std::fmaxf(std::fmaxf(color.r, color.g), color.b);
+        const float maxDistance{ (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic) };
+        fillLights.emplace_back(position, Constants::LIGHT_RADIUS, color, maxDistance, linear, quadratic);
+    }
+
     shaderLightingPass.use();
     shaderLightingPass.setInt("gPosition", 0);
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedoSpec", 2);
     shaderLightingPass.setInt("shadowMaps", 3);
+    shaderLightingPass.setInt("shadowRayCounts", 4);
+
+    // Ray tracer timing. Every frame writes one query and reads the other, which is a frame
+    // old by then, so we never wait on the GPU.
+    unsigned int rayTraceQueries[2]{};
+    glGenQueries(2, rayTraceQueries);
+    unsigned int frameIndex{ 0 };
+
+    // rays, binary node fetches, wide node fetches and triangle tests, see TraversalStats in ray_trace.comp
+    unsigned int traversalStatsSSBO{};
+    glGenBuffers(1, &traversalStatsSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, traversalStatsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // compared pixels and the summed squared differences of both light sampling methods, see SamplingVariance in ray_trace.comp
+    unsigned int samplingVarianceSSBO{};
+    glGenBuffers(1, &samplingVarianceSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, samplingVarianceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // every light, the shadowed ones first and then the fill lights, see Lights in ray_trace.comp.
+    // It's reallocated to the lights in use every frame, so that lights.length() in the shaders counts them.
+    unsigned int lightSSBO{};
+    glGenBuffers(1, &lightSSBO);
 
     // =================================================================================================
     // RENDER LOOP
@@ -279,13 +397,41 @@ int main() {
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        Utility::setupImguiWindow(renderSettings);
+        Utility::setupImguiWindow(renderSettings, renderStats);
+
+        // Move the boxes if requested. Only their instances get updated and the TLAS is refit.
+        bool objectsMoved{ false };
+        if (renderSettings.animateObjects) {
+            for (unsigned int i{ 0 }; i < objectPositions.size(); ++i) {
+                const float offset{ 0.25f * std::sin(2.0f * currentFrame + static_cast<float>(i)) };
+
+                glm::mat4 model{ glm::mat4(1.0f) };
+                model = glm::translate(model, objectPositions[i] + glm::vec3{ 0.0f, offset, 0.0f });
+                model = glm::scale(model, glm::vec3(0.7f));
+
+                objectsMoved = objectsMoved || model != objectTransforms[i];
+                objectTransforms[i] = model;
+                accelerationStructure.setInstanceTransform(objectInstances[i], model);
+            }
+        }
+
+        // Swap the crates over to the GPU built mesh and rebuild it every frame
+        for (uint32_t instance : objectInstances)
+            accelerationStructure.setInstanceMesh(instance, renderSettings.gpuBuildCrateBLAS ? gpuCubeMesh : cubeMesh);
+        if (renderSettings.gpuBuildCrateBLAS)
+            accelerationStructure.rebuildDynamicMesh(gpuCubeMesh, cubeTriangleSSBO, cubeTriangleCount);
+
+        accelerationStructure.update();
 
         // 1. geometry pass: render scene's geometry/color data into gbuffer
         glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // The object ID buffer is an integer one, which glClear doesn't handle
+        const GLuint noObject[4]{ 0xFFFFFFFF, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 3, noObject);
+
         glm::mat4 projection{ glm::perspective(glm::radians(renderSettings.camera.Zoom), static_cast<float>(Constants::SCR_WIDTH) / static_cast<float>(Constants::SCR_HEIGHT), 0.1f, 100.0f) };
         glm::mat4 view = { renderSettings.camera.GetViewMatrix() };
         glm::mat4 model = { glm::mat4(1.0f) };
@@ -309,6 +455,7 @@ int main() {
         for (unsigned int i{ 0 }; i < objectPositions.size(); ++i)
         {
             shaderGeometryPass.setMat4("model", objectTransforms[i]);
+            shaderGeometryPass.setUInt("objectID", i);
 
             Utility::renderCube();
         }
@@ -323,14 +470,319 @@ int main() {
         glBindTexture(GL_TEXTURE_2D, floorSpecularMap);
 
         shaderGeometryPass.setMat4("model", floorModel);
+        shaderGeometryPass.setUInt("objectID", static_cast<unsigned int>(objectPositions.size()));
 
         Utility::renderFloor();
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        // Radius of each light's influence, where its attenuation drops below 5 / 256
+        std::array<float, Constants::NR_LIGHTS> lightMaxDistances{};
+        for (unsigned int i{ 0 }; i < Constants::NR_LIGHTS; ++i) {
+            const float constant{ 1.0f };
+            const float linear{ 0.22f };
+            const float quadratic{ 0.20f };
+            const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
+            lightMaxDistances[i] = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
+        }
+
+        // The same lights for the passes that loop over them on the GPU, and the fill lights after them
+        std::vector<LightGPU> lights{};
+        for (unsigned int i{ 0 }; i < Constants::NR_LIGHTS; ++i)
+            lights.emplace_back(lightPositions[i], Constants::LIGHT_RADIUS, lightColors[i], lightMaxDistances[i], 0.22f, 0.20f);
+        const int fillLightCount{ std::clamp(renderSettings.fillLights, 0, static_cast<int>(Constants::MAX_FILL_LIGHTS)) };
+        lights.insert(lights.end(), fillLights.begin(), fillLights.begin() + fillLightCount);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, lights.size() * sizeof(LightGPU), lights.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // 1.4. Which lights' shadows changed since last frame, the others keep their layer of the
+        // shadow array. Changed ones are traced until temporal accumulation has converged.
+        std::array<ShadowCache::LightState, Constants::NR_LIGHTS> lightStates{};
+        for (unsigned int i{ 0 }; i < Constants::NR_LIGHTS; ++i)
+            lightStates[i] = ShadowCache::LightState{ lightPositions[i], lightColors[i], lightMaxDistances[i] };
+
+        // The boxes are the only thing that moves, the floor stays where it is
+        std::vector<ShadowCache::Object> shadowCasters{};
+        for (unsigned int i{ 0 }; i < objectTransforms.size(); ++i)
+            shadowCasters.push_back(ShadowCache::Object{ objectTransforms[i], accelerationStructure.instanceBounds(objectInstances[i]) });
+
+        // Everything the shadow rays can hit, for the tile classifier. Crates are closed and convex, the floor is only convex.
+        std::vector<ShadowTileClassifier::Occluder> occluders{};
+        const auto addOccluder{ [&](uint32_t instance, uint32_t objectID, uint32_t flags) {
+            const BVH::AABB bounds{ accelerationStructure.instanceBounds(instance) };
+            occluders.push_back(ShadowTileClassifier::Occluder{ bounds.min, objectID, bounds.max, flags });
+        } };
+        for (unsigned int i{ 0 }; i < objectInstances.size(); ++i)
+            addOccluder(objectInstances[i], i, ShadowTileClassifier::CONVEX | ShadowTileClassifier::CLOSED);
+        addOccluder(floorInstance, static_cast<uint32_t>(objectPositions.size()), ShadowTileClassifier::CONVEX);
+
+        const int settleFrames{ renderSettings.temporalAccumulation ?
+            static_cast<int>(std::ceil(ShadowTemporalFilter::effectiveFrames(renderSettings.temporalMinBlend))) : 1 };
+        if (!renderSettings.cacheShadows)
+            shadowCache.invalidate();
+        shadowCache.beginFrame(projection * view, shadowCasters, renderSettings, lightStates, settleFrames);
+
+        // Batched tracing can't leave lights or pixels out, so it traces all of them if anything changed
+        const bool traceAnyShadow{ shadowCache.tracedLights() > 0 };
+        std::array<ShadowCache::Trace, Constants::NR_LIGHTS> shadowTraces{};
+        for (unsigned int i{ 0 }; i < Constants::NR_LIGHTS; ++i) {
+            shadowTraces[i] = renderSettings.batchLights ? (traceAnyShadow ? ShadowCache::Trace::full : ShadowCache::Trace::none) :
+                shadowCache.trace(i);
+        }
+        renderStats.tracedShadowLights = static_cast<unsigned int>(Constants::NR_LIGHTS -
+            std::count(shadowTraces.begin(), shadowTraces.end(), ShadowCache::Trace::none));
+        renderStats.regionTracedShadowLights = static_cast<unsigned int>(
+            std::count(shadowTraces.begin(), shadowTraces.end(), ShadowCache::Trace::regions));
+
+        // 1.5. Cube shadow maps, which hybrid shadows classify the pixels with. Lights only traced
+        // in the dirty tiles trace every pixel there and don't need them.
+        if (renderSettings.hybridShadows && std::count(shadowTraces.begin(), shadowTraces.end(), ShadowCache::Trace::full) > 0)
+            hybridShadows.renderShadowMaps(lightPositions, lightMaxDistances, drawShadowCasters);
+
+        // 1.6. One light per pixel, out of all of them, that the ray tracer then only traces
+        const bool reservoirLighting{ renderSettings.reservoirLighting };
+        if (reservoirLighting) {
+            const LightReservoirs::Parameters reservoirParameters{
+                renderSettings.reservoirCandidates,
+                renderSettings.reservoirTemporalReuse,
+                renderSettings.reservoirSpatialSamples,
+                renderSettings.reservoirSpatialRadius,
+            };
+            lightReservoirs.resample(gPosition, gNormal, gAlbedoSpec, lightSSBO, renderSettings.camera.Position,
+                renderSettings.rotateSamples ? frameIndex : 0, reservoirParameters);
+        }
+
+        // 1.7. Which lights reach each tile of the screen, for the lighting pass
+        const bool tiledLighting{ renderSettings.tiledLighting && !reservoirLighting };
+        if (tiledLighting) {
+            lightCulling.cull(gPosition, lightSSBO);
+            if (renderSettings.collectTraversalStats)
+                renderStats.lightTileOverflows = lightCulling.readOverflowedTiles();
+        }
+
+        // 1.8. The triangles that can block each light's shadow rays, in world space, and which
+        // object they belong to. The crates and the floor are all convex. Nothing reads the lists
+        // if no shadow is traced, and as long as nothing moved they're still right when one is.
+        if (renderSettings.cullLightTriangles && (traceAnyShadow || objectsMoved)) {
+            std::vector<TriangleGPU> sceneTriangles{};
+            std::vector<LightTriangles::Object> sceneObjects{};
+            const auto addObject{ [&](const std::vector<TriangleGPU>& triangles, const glm::mat4& model, uint32_t objectID) {
+                sceneObjects.push_back(LightTriangles::Object{ static_cast<uint32_t>(sceneTriangles.size()), static_cast<uint32_t>(triangles.size()),
+                    objectID, LightTriangles::CONVEX });
+                for (const TriangleGPU& triangle : triangles)
+                    sceneTriangles.emplace_back(model * triangle.v0, model * triangle.v1, model * triangle.v2, triangle.normal, triangle.id);
+            } };
+            for (unsigned int i{ 0 }; i < objectTransforms.size(); ++i)
+                addObject(cubeTriangles, objectTransforms[i], i);
+            addObject(floorTriangles, floorModel, static_cast<uint32_t>(objectPositions.size()));
+
+            lightTriangles.build(sceneTriangles, sceneObjects, lightPositions, lightMaxDistances, Constants::LIGHT_RADIUS);
+            renderStats.lightTriangles = lightTriangles.listedTriangles();
+            renderStats.lightObjects = lightTriangles.listedObjects();
+            renderStats.lightTriangleOverflows = lightTriangles.overflowedLights();
+        }
+
         // 2. Ray Tracer Pass
-        for (unsigned int i = 0; i < Constants::NR_LIGHTS; ++i)
+        if (renderSettings.collectTraversalStats) {
+            const uint32_t zero{ 0 };
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, traversalStatsSSBO);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        const bool compareLightSampling{ renderSettings.lightSampling == Settings::LightSampling::compare };
+        if (compareLightSampling) {
+            const uint32_t zero{ 0 };
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, samplingVarianceSSBO);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        const glm::ivec2 screenSize{ Constants::SCR_WIDTH, Constants::SCR_HEIGHT };
+        const Utility::ScreenRect fullScreen{ glm::ivec2{ 0 }, screenSize };
+        float scissoredPixels{ 0.0f };
+        uint32_t hybridTracedPixels{ 0 };
+        uint32_t tileTracedPixels{ 0 };
+
+        glBeginQuery(GL_TIME_ELAPSED, rayTraceQueries[frameIndex % 2]);
+
+        // Uniforms and buffers that are the same for every light. Classifying and upsampling
+        // switch programs, but uniforms stay with their program.
+        rayTraceShader.use();
+        rayTraceShader.setInt("shadowSampler", static_cast<int>(renderSettings.shadowSampler));
+        rayTraceShader.setInt("sampleCount", renderSettings.shadowSamples);
+        rayTraceShader.setInt("lightSampling", static_cast<int>(renderSettings.lightSampling));
+        rayTraceShader.setUInt("frameIndex", renderSettings.rotateSamples ? frameIndex : 0);
+        rayTraceShader.setBool("adaptiveSampling", renderSettings.adaptiveSampling);
+        rayTraceShader.setInt("initialSampleCount", renderSettings.adaptiveInitialSamples);
+        rayTraceShader.setFloat("agreementThreshold", renderSettings.adaptiveThreshold);
+        rayTraceShader.setVec3("viewPos", renderSettings.camera.Position);
+        rayTraceShader.setBool("collectStats", renderSettings.collectTraversalStats);
+        rayTraceShader.setBool("batchLights", renderSettings.batchLights);
+        rayTraceShader.setBool("traceReservoirs", reservoirLighting);
+        rayTraceShader.setInt("reservoirShadowRays", renderSettings.reservoirShadowRays);
+        rayTraceShader.setBool("traceLightTriangles", renderSettings.cullLightTriangles);
+
+        // bind triangle, BVH and instance SSBOs
+        accelerationStructure.bind();
+        lightTriangles.bind();
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, traversalStatsSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, samplingVarianceSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, hybridShadows.pixelList());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, lightReservoirs.reservoirs());
+
+        // Reservoirs can pick any light. Batched tracing only gets the shadowed ones, the fill
+        // lights have no layer to trace into.
+        if (reservoirLighting)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, lightSSBO);
+        else
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 13, lightSSBO, 0, Constants::NR_LIGHTS * sizeof(LightGPU));
+
+        // The one light each pixel's reservoir picked, a few rays per pixel however many lights there are
+        if (reservoirLighting) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gPosition);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, gNormal);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, blueNoiseTexture);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, gObjectID);
+
+            const ShadowUpsampler::Pattern pattern{ ShadowUpsampler::pattern(Settings::ShadowResolution::full, 0) };
+            rayTraceShader.setInt("resolutionScale", pattern.scale);
+            rayTraceShader.setBool("checkerboard", pattern.checkerboard);
+            rayTraceShader.setIVec2("pixelOffset", pattern.offset);
+            rayTraceShader.setBool("tracePixelList", false);
+            rayTraceShader.setIVec2("firstInvocation", glm::ivec2{ 0 });
+
+            rayTraceShader.dispatch((Constants::SCR_WIDTH + 16 - 1) / 16, (Constants::SCR_HEIGHT + 16 - 1) / 16);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            lightReservoirs.endFrame(projection * view, gPosition, gNormal);
+        }
+        else
+            lightReservoirs.reset();
+
+        // Every light in one dispatch. Each pixel fetches its G-buffer texel once and loops over
+        // the lights, at full resolution and over the rectangle all of their scissors cover.
+        if (renderSettings.batchLights && !reservoirLighting && traceAnyShadow) {
+            Utility::ScreenRect scissor{ screenSize, glm::ivec2{ 0 } };
+            for (unsigned int i = 0; i < Constants::NR_LIGHTS; ++i) {
+                const Utility::ScreenRect lightScissor{ renderSettings.scissorLights ?
+                    Utility::projectSphere(lightPositions[i], lightMaxDistances[i], projection * view, screenSize) : fullScreen };
+                scissoredPixels += static_cast<float>(lightScissor.size().x * lightScissor.size().y);
+                if (!lightScissor.empty()) {
+                    scissor.min = glm::min(scissor.min, lightScissor.min);
+                    scissor.max = glm::max(scissor.max, lightScissor.max);
+                }
+            }
+
+            // Outside the rectangle every light is lit, without rays
+            if (scissor.min != fullScreen.min || scissor.max != fullScreen.max) {
+                const float lit{ 1.0f };
+                const uint8_t noRays{ 0 };
+                glClearTexImage(gRayTracedShadowsArray, 0, GL_RED, GL_FLOAT, &lit);
+                glClearTexImage(gShadowRayCountArray, 0, GL_RED, GL_UNSIGNED_BYTE, &noRays);
+            }
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gPosition);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, gNormal);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, blueNoiseTexture);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, gObjectID);
+
+            const ShadowUpsampler::Pattern pattern{ ShadowUpsampler::pattern(Settings::ShadowResolution::full, 0) };
+            rayTraceShader.setInt("resolutionScale", pattern.scale);
+            rayTraceShader.setBool("checkerboard", pattern.checkerboard);
+            rayTraceShader.setIVec2("pixelOffset", pattern.offset);
+            rayTraceShader.setBool("tracePixelList", false);
+
+            // every layer at once
+            glBindImageTexture(2, gRayTracedShadowsArray, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
+            glBindImageTexture(3, gShadowRayCountArray, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R8);
+
+            if (!scissor.empty()) {
+                const ShadowUpsampler::TraceDispatch dispatch{ ShadowUpsampler::traceDispatch(pattern, scissor) };
+                rayTraceShader.setIVec2("firstInvocation", dispatch.firstInvocation);
+                rayTraceShader.dispatch(dispatch.groups.x, dispatch.groups.y);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+        }
+
+        // Or one dispatch per light, which lets every light have its own resolution and pixels
+        for (unsigned int i = 0; i < Constants::NR_LIGHTS && !renderSettings.batchLights && !reservoirLighting; ++i)
         {
+            // Nothing this light's shadow depends on changed, last frame's layer is still right
+            if (shadowTraces[i] == ShadowCache::Trace::none)
+                continue;
+
+            // Or only objects moved, and just the tiles they can have changed are traced, at full
+            // resolution, on top of last frame's shadow from before it was denoised
+            const bool regionsOnly{ shadowTraces[i] == ShadowCache::Trace::regions };
+
+            const float maxDistance{ lightMaxDistances[i] };
+
+            // Pixels beyond maxDistance don't get any light from it, so only the screen rectangle
+            // of its sphere of influence is traced. The rest is lit, which is what the ray tracer
+            // would have found there as well.
+            const Utility::ScreenRect scissor{ renderSettings.scissorLights ?
+                Utility::projectSphere(lightPositions[i], maxDistance, projection * view, screenSize) : fullScreen };
+            const bool scissored{ scissor.min != fullScreen.min || scissor.max != fullScreen.max };
+            scissoredPixels += static_cast<float>(scissor.size().x * scissor.size().y);
+
+            // Lower resolutions trace into the upsampler's scratch texture instead of the light's layer.
+            // Hybrid shadows and tile classification pick their own pixels, at full resolution.
+            const bool classifyTiles{ renderSettings.classifyShadowTiles && !renderSettings.hybridShadows && !regionsOnly };
+            const bool pixelList{ renderSettings.hybridShadows || regionsOnly || classifyTiles };
+            const ShadowUpsampler::Pattern pattern{ ShadowUpsampler::pattern(pixelList ?
+                Settings::ShadowResolution::full : renderSettings.shadowResolutions[i], renderSettings.rotateSamples ? frameIndex : 0) };
+            const bool fullResolution{ pattern.scale == 1 && !pattern.checkerboard };
+
+            if (regionsOnly) {
+                shadowInvalidation.restore(gRayTracedShadowsArray, i);
+                shadowInvalidation.markDirtyTiles(gPosition, renderSettings.camera.Position, lightPositions[i], Constants::LIGHT_RADIUS,
+                    shadowCache.dirtyBoxes());
+            }
+            else if (scissored) {
+                const float lit{ 1.0f };
+                glClearTexSubImage(gRayTracedShadowsArray, 0, 0, 0, i, Constants::SCR_WIDTH, Constants::SCR_HEIGHT, 1, GL_RED, GL_FLOAT, &lit);
+
+                // The upsample looks at traced pixels just outside the rectangle too
+                if (!fullResolution)
+                    glClearTexImage(shadowUpsampler.sparseTexture(), 0, GL_RED, GL_FLOAT, &lit);
+            }
+
+            // Pixels that aren't traced spend no rays, which the ray tracer doesn't write
+            if (!regionsOnly && (!fullResolution || scissored)) {
+                const uint8_t noRays{ 0 };
+                glClearTexSubImage(gShadowRayCountArray, 0, 0, 0, i, Constants::SCR_WIDTH, Constants::SCR_HEIGHT, 1, GL_RED, GL_UNSIGNED_BYTE, &noRays);
+            }
+
+            // The shadow map settles most pixels, the ray tracer only gets the ones it isn't sure about
+            if (renderSettings.hybridShadows && !regionsOnly) {
+                hybridShadows.classify(gRayTracedShadowsArray, gShadowRayCountArray, i, gPosition, gNormal,
+                    i, lightPositions[i], Constants::LIGHT_RADIUS, maxDistance, renderSettings.hybridMinBlockerDistance, scissor);
+
+                if (renderSettings.collectTraversalStats)
+                    hybridTracedPixels += hybridShadows.readPixelCount();
+            }
+
+            // Or the bounds of the scene settle whole tiles, and the ray tracer gets the ones in between
+            if (classifyTiles) {
+                shadowTileClassifier.classify(gRayTracedShadowsArray, gShadowRayCountArray, i, gPosition, gNormal, gObjectID,
+                    lightPositions[i], Constants::LIGHT_RADIUS, maxDistance, occluders, scissor);
+
+                if (renderSettings.collectTraversalStats)
+                    tileTracedPixels += shadowTileClassifier.readPixelCount();
+            }
+
             rayTraceShader.use();
 
             // bind G-buffer textures
@@ -340,34 +792,151 @@ int main() {
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, gNormal);
 
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, blueNoiseTexture);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, gObjectID);
+
+            rayTraceShader.setInt("resolutionScale", pattern.scale);
+            rayTraceShader.setBool("checkerboard", pattern.checkerboard);
+            rayTraceShader.setIVec2("pixelOffset", pattern.offset);
+            rayTraceShader.setBool("tracePixelList", pixelList);
+            rayTraceShader.setBool("pixelListTiles", regionsOnly || classifyTiles);
+
             // send uniforms for only this light
+            rayTraceShader.setInt("lightIndex", static_cast<int>(i));
             rayTraceShader.setVec3("light.Position", lightPositions[i]);
             rayTraceShader.setVec3("light.Color", lightColors[i]);
 
-            const float constant{ 1.0f };
             const float linear{ 0.22f };
             const float quadratic{ 0.20f };
             rayTraceShader.setFloat("light.Linear", linear);
             rayTraceShader.setFloat("light.Quadratic", quadratic);
-
-            const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-            float maxDistance{ (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic) };
             rayTraceShader.setFloat("light.MaxDistance", maxDistance);
             rayTraceShader.setFloat("light.Radius", Constants::LIGHT_RADIUS);
 
-            rayTraceShader.setVec3("viewPos", renderSettings.camera.Position);
-
             // bind shadow texture for this light
-            glBindImageTexture(0, gRayTracedShadowsArray, 0, GL_FALSE, i, GL_WRITE_ONLY, GL_R16F);
-
-            // bind triangles SSBO
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, triangleSSBO);
-
-            // dispatch compute shader
-            rayTraceShader.dispatch((Constants::SCR_WIDTH + 16 - 1) / 16, (Constants::SCR_HEIGHT + 16 - 1) / 16);
+            if (fullResolution)
+                glBindImageTexture(0, gRayTracedShadowsArray, 0, GL_FALSE, i, GL_WRITE_ONLY, GL_R16F);
+            else
+                glBindImageTexture(0, shadowUpsampler.sparseTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+            glBindImageTexture(1, gShadowRayCountArray, 0, GL_FALSE, i, GL_WRITE_ONLY, GL_R8);
+
+            // dispatch compute shader, unless the light is entirely off screen
+            if (scissor.empty())
+                continue;
+
+            if (regionsOnly) {
+                rayTraceShader.dispatchIndirect(shadowInvalidation.pixelList());
+            }
+            else if (renderSettings.hybridShadows) {
+                rayTraceShader.dispatchIndirect(hybridShadows.pixelList());
+            }
+            else if (classifyTiles) {
+                rayTraceShader.dispatchIndirect(shadowTileClassifier.pixelList());
+            }
+            else {
+                const ShadowUpsampler::TraceDispatch dispatch{ ShadowUpsampler::traceDispatch(pattern, scissor) };
+                rayTraceShader.setIVec2("firstInvocation", dispatch.firstInvocation);
+                rayTraceShader.dispatch(dispatch.groups.x, dispatch.groups.y);
+            }
 
             // make sure writes are visible before next light
             glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+            if (!fullResolution)
+                shadowUpsampler.upsample(gRayTracedShadowsArray, i, gPosition, gNormal, renderSettings.camera.Position, pattern, scissor);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+
+        renderStats.scissoredScreenFraction = scissoredPixels / static_cast<float>(Constants::NR_LIGHTS * Constants::SCR_WIDTH * Constants::SCR_HEIGHT);
+        if (renderSettings.hybridShadows && renderSettings.collectTraversalStats)
+            renderStats.hybridTracedFraction = static_cast<float>(hybridTracedPixels) / static_cast<float>(Constants::NR_LIGHTS * Constants::SCR_WIDTH * Constants::SCR_HEIGHT);
+        if (renderSettings.classifyShadowTiles && renderSettings.collectTraversalStats)
+            renderStats.tileTracedFraction = static_cast<float>(tileTracedPixels) / static_cast<float>(Constants::NR_LIGHTS * Constants::SCR_WIDTH * Constants::SCR_HEIGHT);
+
+        // 2.5. Blend this frame's shadows into the history of each light. Reservoirs keep their own history,
+        // and lights that weren't traced keep theirs as it is.
+        if (renderSettings.temporalAccumulation && !reservoirLighting) {
+            if (traceAnyShadow) {
+                for (unsigned int i = 0; i < Constants::NR_LIGHTS; ++i) {
+                    if (shadowTraces[i] != ShadowCache::Trace::none)
+                        shadowTemporalFilter.accumulate(gRayTracedShadowsArray, i, gPosition, gNormal, renderSettings.temporalMinBlend);
+                    else
+                        shadowTemporalFilter.keep(i);
+                }
+                shadowTemporalFilter.endFrame(projection * view, gPosition, gNormal);
+            }
+        }
+        else
+            shadowTemporalFilter.reset();
+
+        // What the dirty tiles of the next frames are traced on top of, only needed when they're used
+        if (renderSettings.cacheShadows && renderSettings.invalidateDirtyRegions && !reservoirLighting) {
+            for (unsigned int i = 0; i < Constants::NR_LIGHTS; ++i) {
+                if (shadowTraces[i] != ShadowCache::Trace::none)
+                    shadowInvalidation.store(gRayTracedShadowsArray, i);
+            }
+        }
+
+        // 2.6. Blur the rest of the noise away
+        if (renderSettings.denoiseShadows && !reservoirLighting) {
+            const ShadowDenoiser::Parameters denoiseParameters{
+                renderSettings.denoiseIterations,
+                renderSettings.denoiseStepWidth,
+                renderSettings.denoiseNormalPhi,
+                renderSettings.denoisePlanePhi,
+                renderSettings.denoiseVisibilityPhi,
+            };
+            const ShadowDenoiser::Noise noise{
+                renderSettings.temporalAccumulation ? shadowTemporalFilter.history() : 0,
+                renderSettings.shadowSamples,
+                ShadowTemporalFilter::effectiveFrames(renderSettings.temporalMinBlend),
+            };
+            for (unsigned int i = 0; i < Constants::NR_LIGHTS; ++i) {
+                if (shadowTraces[i] != ShadowCache::Trace::none)
+                    shadowDenoiser.denoise(gRayTracedShadowsArray, i, gPosition, gNormal, gObjectID, renderSettings.camera.Position, noise, denoiseParameters);
+            }
+        }
+
+        // Read last frame's timing if it's there, otherwise keep showing the one before
+        if (frameIndex > 0) {
+            GLint available{ 0 };
+            glGetQueryObjectiv(rayTraceQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed{ 0 };
+                glGetQueryObjectui64v(rayTraceQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &elapsed);
+                renderStats.rayTraceMilliseconds = static_cast<float>(elapsed) / 1.0e6f;
+            }
+        }
+        ++frameIndex;
+
+        // Reading the counters back waits for the ray tracer, which is why this is optional
+        if (renderSettings.collectTraversalStats) {
+            uint32_t counters[4]{};
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, traversalStatsSSBO);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            renderStats.shadowRays = counters[0];
+            renderStats.nodeBytesFetched = static_cast<uint64_t>(counters[1]) * sizeof(BVHNodeGPU) +
+                static_cast<uint64_t>(counters[2]) * accelerationStructure.wideNodeSize();
+            renderStats.triangleBytesFetched = static_cast<uint64_t>(counters[3]) * accelerationStructure.triangleTestSize();
+        }
+
+        if (compareLightSampling) {
+            uint32_t sums[3]{};
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, samplingVarianceSSBO);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(sums), sums);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            // The shader sums (A - B)^2 scaled by 1024, which is twice the variance of either estimate
+            const float scale{ 1.0f / (2.0f * 1024.0f * static_cast<float>(std::max(sums[0], 1u))) };
+            renderStats.comparedPixels = sums[0];
+            renderStats.sphereSamplingVariance = static_cast<float>(sums[1]) * scale;
+            renderStats.coneSamplingVariance = static_cast<float>(sums[2]) * scale;
         }
 
         // 3. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
@@ -389,30 +958,21 @@ int main() {
 
         // Defines how we render the objects, see deferred_shading.frag for details
         shaderLightingPass.setInt("renderingMode", static_cast<int>(renderSettings.deferredShadingRenderMode));
+        shaderLightingPass.setBool("reservoirLighting", reservoirLighting);
+        shaderLightingPass.setBool("tiledLighting", tiledLighting);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, lightReservoirs.reservoirs());
 
-        // send light relevant uniforms
-        for (unsigned int i{ 0 }; i < lightPositions.size(); ++i)
-        {
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+        // every light, shadowed and fill, and the lights of each tile
+        shaderLightingPass.setInt("shadowedLights", static_cast<int>(Constants::NR_LIGHTS));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, lightSSBO);
+        lightCulling.bind();
 
-            // update attenuation parameters and calculate radius
-            const float constant{ 1.0f };
-            const float linear{ 0.22f };
-            const float quadratic{ 0.20f };
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
-
-            // then calculate radius of light volume/sphere
-            const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-            float maxDistance{ (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic) };
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].MaxDistance", maxDistance);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Radius", Constants::LIGHT_RADIUS);
+        // bind ray tracer image
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, gRayTracedShadowsArray);
 
-            // bind ray tracer image
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D_ARRAY, gRayTracedShadowsArray);
-        }
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, gShadowRayCountArray);
 
         shaderLightingPass.setVec3("viewPos", renderSettings.camera.Position);
 
@@ -450,7 +1010,7 @@ int main() {
         glfwPollEvents();
         
         if (firstRenderPass) {
-            PLOGD << "Num Triangles in Scene: " << gpuTriangles.size();
+            PLOGD << "Num Triangles in Scene: " << accelerationStructure.instancedTriangleCount();
             firstRenderPass = false;
         }
             
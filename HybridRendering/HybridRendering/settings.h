@@ -1,6 +1,9 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <array>
+#include <cstdint>
+
 #include "constants.h"
 #include "camera.h"
 
@@ -24,9 +27,43 @@ namespace Settings {
 	enum class DeferredShadingRenderMode {
 		texture, // 0
 		shadows, // 1
+		raysPerPixel, // 2, how many shadow rays the first light's pixels got, see adaptiveSampling
+		lightsPerTile, // 3, how many lights the lighting pass loops over, see tiledLighting
 		num_options
 	};
 
+	/*
+		Where the ray tracer gets its random numbers from, see sampleSquare() in ray_trace.comp
+	*/
+	enum class ShadowSampler {
+		hash, // 0, the original sine hash, white noise
+		r2, // 1, R2 sequence, shifted by a hashed offset per pixel
+		sobol, // 2, Owen scrambled Sobol sequence, scrambled per pixel
+		blueNoise, // 3, R2 sequence, shifted by a blue noise offset per pixel
+		num_options, // 4
+	};
+
+	/*
+		How those random numbers become points on the area light, see sampleLight() in ray_trace.comp
+	*/
+	enum class LightSampling {
+		sphere, // 0, uniform over the sphere's surface, back included
+		cone, // 1, uniform over the directions the sphere covers
+		compare, // 2, traces both and measures their variance, left half sphere, right half cone
+		num_options, // 3
+	};
+
+	/*
+		Which pixels the ray tracer shoots rays for, the rest get upsampled, see ShadowUpsampler
+	*/
+	enum class ShadowResolution {
+		full, // 0
+		half, // 1, one pixel of every 2x2 block
+		quarter, // 2, one pixel of every 4x4 block
+		checkerboard, // 3, every other pixel, alternating each frame
+		num_options, // 4
+	};
+
 	/*
 		Defines various render settings
 	*/
@@ -35,11 +72,139 @@ namespace Settings {
 		DeferredShadingRenderMode deferredShadingRenderMode { DeferredShadingRenderMode::texture };
 		bool enableMouseLook{ false };
 
+		// Bobs the boxes up and down to exercise the dynamic acceleration structure path
+		bool animateObjects{ false };
+
+		// Rebuilds the crates' BLAS on the GPU every frame, like a mesh whose triangles change would be
+		bool gpuBuildCrateBLAS{ false };
+
+		// Counts the BVH nodes every shadow ray fetches. This reads a buffer back every frame, so it's off by default.
+		bool collectTraversalStats{ false };
+
+		// Blue noise leaves the error of a few samples as a fine grain, which temporal accumulation
+		// then averages out, so 2 per frame end up looking like many more
+		ShadowSampler shadowSampler{ ShadowSampler::blueNoise };
+		int shadowSamples{ 2 };
+		LightSampling lightSampling{ LightSampling::cone };
+
+		// Per light, so that lights that matter less can be traced at a lower resolution
+		std::array<ShadowResolution, Constants::NR_LIGHTS> shadowResolutions{};
+
+		// Only traces the screen rectangle each light can reach, see Utility::projectSphere
+		bool scissorLights{ true };
+
+		// Settles lit and umbra pixels with a cube shadow map and only traces the rest, see HybridShadows.
+		// Blockers closer to a light than hybridMinBlockerDistance can be missed by the blocker search.
+		bool hybridShadows{ false };
+		float hybridMinBlockerDistance{ 0.3f };
+
+		// Settles whole tiles that nothing can shadow, or that shadow themselves, from the scene's bounds and
+		// only traces the rest, see ShadowTileClassifier. Hybrid shadows take precedence while they're on.
+		bool classifyShadowTiles{ true };
+
+		// Traces every light in a single dispatch, at full resolution. Per light shadow resolutions
+		// and hybrid shadows need a dispatch per light, so they're ignored while this is on.
+		bool batchLights{ false };
+
+		// Traces one light per pixel, picked by reservoir resampling, instead of every light, see
+		// LightReservoirs. The per light shadows, and with them the shadows and rays per pixel
+		// views, temporal accumulation and denoising, are skipped while this is on.
+		bool reservoirLighting{ false };
+		int reservoirCandidates{ 8 };
+		bool reservoirTemporalReuse{ true };
+		int reservoirSpatialSamples{ 4 };
+		float reservoirSpatialRadius{ 20.0f };
+		int reservoirShadowRays{ 1 };
+
+		// Keeps the shadows of lights whose inputs didn't change instead of tracing them again, see ShadowCache
+		bool cacheShadows{ true };
+
+		// When only objects moved, traces just the tiles whose shadows they can have changed, see ShadowInvalidation
+		bool invalidateDirtyRegions{ true };
+
+		// Has the ray tracer test only the triangles around a light instead of walking the acceleration
+		// structure, for lights with few enough of them, see LightTriangles
+		bool cullLightTriangles{ true };
+
+		// Has the lighting pass loop only over the lights that reach each screen tile, see LightCulling
+		bool tiledLighting{ true };
+
+		// Unshadowed lights scattered over the floor on top of the NR_LIGHTS shadowed ones, up to MAX_FILL_LIGHTS
+		int fillLights{ 0 };
+
+		// Traces adaptiveInitialSamples rays first and only the rest of shadowSamples where they
+		// disagree. Agreeing means less than adaptiveThreshold of them, or more than 1 - adaptiveThreshold,
+		// see the light, so 0 only stops when they all agree. Hybrid shadows always trace them all,
+		// since their pixel list doesn't keep neighbours together.
+		bool adaptiveSampling{ true };
+		int adaptiveInitialSamples{ 4 };
+		float adaptiveThreshold{ 0.0f };
+
+		// Moves the sequences to a different part each frame, so successive frames don't repeat the same error
+		bool rotateSamples{ true };
+
+		// Blends the shadows of each frame into those of the previous ones, see ShadowTemporalFilter
+		bool temporalAccumulation{ true };
+
+		// Smallest weight a new frame gets, lower converges further but takes longer to catch up with changes
+		float temporalMinBlend{ 0.05f };
+
+		// Edge-aware blur of the accumulated shadows, see ShadowDenoiser
+		bool denoiseShadows{ true };
+		int denoiseIterations{ 2 };
+		int denoiseStepWidth{ 1 };
+		float denoiseNormalPhi{ 64.0f };
+		float denoisePlanePhi{ 0.01f };
+		float denoiseVisibilityPhi{ 2.0f };
+
 		Camera camera{ glm::vec3(0.0f, 0.0f, 3.0f) };
 
 		float lastX{ Constants::SCR_WIDTH / 2.0f };
 		float lastY{ Constants::SCR_HEIGHT / 2.0f };
 	};
+
+	/*
+		Measurements of the last frames, shown next to the render settings
+	*/
+	struct RenderStats {
+		const char* blasLayout{ "" };
+		const char* triangleLayout{ "" };
+
+		// GPU time of the ray tracer pass, over all lights
+		float rayTraceMilliseconds{ 0.0f };
+
+		// Lights whose shadows were traced this frame, the rest came from ShadowCache
+		unsigned int tracedShadowLights{ 0 };
+		unsigned int regionTracedShadowLights{ 0 }; // of those, the ones only traced around moving objects
+
+		// Triangles and objects listed for the lights, and lights with too many to list, see LightTriangles
+		uint32_t lightTriangles{ 0 };
+		uint32_t lightObjects{ 0 };
+		uint32_t lightTriangleOverflows{ 0 };
+
+		// Screen tiles that reached more lights than LightCulling lists, and were shaded with all of them. Needs collectTraversalStats.
+		uint32_t lightTileOverflows{ 0 };
+
+		// Share of the screen inside the lights' scissor rectangles, averaged over the lights
+		float scissoredScreenFraction{ 1.0f };
+
+		// Share of the screen hybrid shadows still traced, averaged over the lights. Needs collectTraversalStats.
+		float hybridTracedFraction{ 0.0f };
+
+		// Share of the screen tile classification still traced, averaged over the lights. Needs collectTraversalStats.
+		float tileTracedFraction{ 0.0f };
+
+		// Only filled in while lightSampling is compare. The average variance of a pixel's
+		// visibility in the penumbrae, for either way of sampling the light.
+		uint32_t comparedPixels{ 0 };
+		float sphereSamplingVariance{ 0.0f };
+		float coneSamplingVariance{ 0.0f };
+
+		// Only filled in while collectTraversalStats is on
+		uint32_t shadowRays{ 0 };
+		uint64_t nodeBytesFetched{ 0 };
+		uint64_t triangleBytesFetched{ 0 };
+	};
 }
 
 #endif
\ No newline at end of file
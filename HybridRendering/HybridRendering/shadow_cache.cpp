@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <tuple>
+
+#include "shadow_cache.h"
+
+namespace {
+    // Everything in the settings that changes what ends up in the shadow array
+    auto shadowSettings(const Settings::RenderSettings& settings) {
+        return std::tie(
+            settings.shadowSampler, settings.shadowSamples, settings.lightSampling, settings.shadowResolutions,
+            settings.scissorLights, settings.hybridShadows, settings.hybridMinBlockerDistance, settings.classifyShadowTiles, settings.batchLights,
+            settings.reservoirLighting, settings.adaptiveSampling, settings.adaptiveInitialSamples, settings.adaptiveThreshold,
+            settings.rotateSamples, settings.temporalAccumulation, settings.temporalMinBlend,
+            settings.denoiseShadows, settings.denoiseIterations, settings.denoiseStepWidth,
+            settings.denoiseNormalPhi, settings.denoisePlanePhi, settings.denoiseVisibilityPhi,
+            settings.gpuBuildCrateBLAS, settings.cullLightTriangles, settings.collectTraversalStats, settings.invalidateDirtyRegions
+        );
+    }
+}
+
+ShadowCache::ShadowCache(unsigned int lights)
+    : framesSinceChange(lights, 0)
+{
+}
+
+void ShadowCache::beginFrame(const glm::mat4& viewProjection, std::span<const Object> objects,
+    const Settings::RenderSettings& settings, std::span<const LightState> lights, int settleFrames) {
+    this->settleFrames = std::max(settleFrames, 1);
+
+    bool sceneChanged{ !valid || viewProjection != previousViewProjection || objects.size() != previousObjects.size() ||
+        shadowSettings(settings) != shadowSettings(previousSettings) };
+
+    // Moving objects only dirty the regions around them, unless that's turned off or there are too many
+    const size_t slots{ static_cast<size_t>(this->settleFrames) };
+    if (sceneChanged || sweptBounds.size() != objects.size() * slots) {
+        sweptBounds.assign(objects.size() * slots, BVH::AABB{});
+        framesSinceMove.assign(objects.size(), this->settleFrames);
+        frameSlot = 0;
+    }
+    else {
+        frameSlot = (frameSlot + 1) % slots;
+        for (size_t i{ 0 }; i < objects.size(); ++i) {
+            // Overwrites what the object swept through settleFrames frames ago
+            BVH::AABB& swept{ sweptBounds[i * slots + frameSlot] };
+            swept = BVH::AABB{};
+            if (objects[i].transform == previousObjects[i].transform) {
+                framesSinceMove[i] = std::min(framesSinceMove[i] + 1, this->settleFrames);
+                continue;
+            }
+
+            swept.grow(previousObjects[i].bounds);
+            swept.grow(objects[i].bounds);
+            framesSinceMove[i] = 0;
+        }
+    }
+
+    activeDirtyBoxes.clear();
+    for (size_t i{ 0 }; i < framesSinceMove.size(); ++i) {
+        if (framesSinceMove[i] >= this->settleFrames)
+            continue;
+
+        BVH::AABB box{};
+        for (size_t slot{ 0 }; slot < slots; ++slot)
+            box.grow(sweptBounds[i * slots + slot]);
+        activeDirtyBoxes.push_back(box);
+    }
+
+    if (!activeDirtyBoxes.empty() && (!settings.invalidateDirtyRegions || activeDirtyBoxes.size() > MAX_DIRTY_BOXES)) {
+        sceneChanged = true;
+        activeDirtyBoxes.clear();
+    }
+
+    for (size_t i{ 0 }; i < framesSinceChange.size(); ++i) {
+        if (sceneChanged || lights[i] != previousLights[i])
+            framesSinceChange[i] = 0;
+        else
+            framesSinceChange[i] = std::min(framesSinceChange[i] + 1, this->settleFrames);
+    }
+
+    valid = true;
+    previousViewProjection = viewProjection;
+    previousObjects.assign(objects.begin(), objects.end());
+    previousSettings = settings;
+    previousLights.assign(lights.begin(), lights.end());
+}
+
+ShadowCache::Trace ShadowCache::trace(unsigned int light) const {
+    if (framesSinceChange[light] < settleFrames)
+        return Trace::full;
+    return activeDirtyBoxes.empty() ? Trace::none : Trace::regions;
+}
+
+unsigned int ShadowCache::tracedLights() const {
+    unsigned int count{ 0 };
+    for (unsigned int i{ 0 }; i < framesSinceChange.size(); ++i)
+        count += needsTrace(i) ? 1 : 0;
+    return count;
+}
+
+unsigned int ShadowCache::regionTracedLights() const {
+    unsigned int count{ 0 };
+    for (unsigned int i{ 0 }; i < framesSinceChange.size(); ++i)
+        count += trace(i) == Trace::regions ? 1 : 0;
+    return count;
+}
+
+void ShadowCache::invalidate() {
+    valid = false;
+}
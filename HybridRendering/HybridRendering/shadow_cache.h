@@ -0,0 +1,96 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "settings.h"
+
+/*
+	Decides which lights' shadows have to be traced again, so a scene where nothing moves stops
+	costing rays. Every frame's inputs are compared to the last frame's:
+
+		camera, shadow settings            ==> every light is traced
+		a light's position, color or range ==> only that light is traced
+		an object's transform              ==> every light, but only in the tiles whose shadow
+		                                       rays or view rays can pass through the object's
+		                                       old or new bounds, see ShadowInvalidation
+
+	Anything else keeps last frame's layer of the shadow array, which already holds the
+	accumulated and denoised result. Whatever changed is traced for settleFrames frames
+	after its last change, long enough for temporal accumulation to converge, and only then
+	frozen. A moving object's dirty box is everything it swept through in those last
+	settleFrames frames, so it follows the object instead of growing while it keeps moving.
+
+	This is all on the CPU. The shadow passes check trace() and skip the light, or only trace
+	around dirtyBoxes().
+*/
+class ShadowCache {
+public:
+	explicit ShadowCache(unsigned int lights);
+
+	// More moving objects than this and the lights are traced fully instead. Has to match shadow_invalidate.comp.
+	static constexpr unsigned int MAX_DIRTY_BOXES{ 16 };
+
+	// What a light's shadow depends on besides the camera and the scene
+	struct LightState {
+		glm::vec3 position;
+		glm::vec3 color;
+		float maxDistance;
+
+		bool operator==(const LightState&) const = default;
+	};
+
+	// Something that casts shadows, its transform and world space bounds
+	struct Object {
+		glm::mat4 transform;
+		BVH::AABB bounds;
+	};
+
+	enum class Trace {
+		none, // last frame's shadow is still right
+		regions, // only around dirtyBoxes()
+		full,
+	};
+
+	// Compares this frame's inputs to last frame's
+	void beginFrame(const glm::mat4& viewProjection, std::span<const Object> objects,
+		const Settings::RenderSettings& settings, std::span<const LightState> lights, int settleFrames);
+
+	Trace trace(unsigned int light) const;
+	bool needsTrace(unsigned int light) const { return trace(light) != Trace::none; }
+
+	// How many lights this frame traces, in full or only in regions
+	unsigned int tracedLights() const;
+	unsigned int regionTracedLights() const;
+
+	// Swept bounds of the objects that moved in the last settleFrames frames
+	const std::vector<BVH::AABB>& dirtyBoxes() const { return activeDirtyBoxes; }
+
+	// Traces every light again, e.g. after the shadow array was used for something else
+	void invalidate();
+
+private:
+	// Frames since each light's inputs last changed, stops counting at settleFrames
+	std::vector<int> framesSinceChange;
+	int settleFrames{ 1 };
+
+	// Per object, what it swept through in each of the last settleFrames frames (empty if it
+	// didn't move), in a ring that frameSlot walks through, and frames since it stopped
+	std::vector<BVH::AABB> sweptBounds{};
+	size_t frameSlot{ 0 };
+	std::vector<int> framesSinceMove{};
+	std::vector<BVH::AABB> activeDirtyBoxes{};
+
+	// Last frame's inputs, not valid before the first beginFrame()
+	bool valid{ false };
+	glm::mat4 previousViewProjection{ 1.0f };
+	std::vector<Object> previousObjects{};
+	Settings::RenderSettings previousSettings{};
+	std::vector<LightState> previousLights{};
+};
+
+#endif // !SHADOW_CACHE_H
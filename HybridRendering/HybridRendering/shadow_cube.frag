@@ -0,0 +1,11 @@
+#version 460 core
+in vec4 FragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+void main()
+{
+    // Linear distance to the light, mapped to [0, 1], instead of the projection's depth
+    gl_FragDepth = length(FragPos.xyz - lightPos) / farPlane;
+}
@@ -0,0 +1,11 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+// Cube shadow maps of the lights, see HybridShadows. The geometry shader does the projection.
+
+uniform mat4 model;
+
+void main()
+{
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,79 @@
+#include <glad/glad.h>
+
+#include "shadow_denoiser.h"
+
+namespace {
+    // Texture units shadow_atrous.comp samples the G-buffer from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+    constexpr int OBJECT_ID_UNIT{ 2 };
+    constexpr int HISTORY_UNIT{ 3 };
+}
+
+ShadowDenoiser::ShadowDenoiser(unsigned int width, unsigned int height)
+    : width{ width }
+    , height{ height }
+{
+    glGenTextures(2, pingPongTextures);
+    for (unsigned int texture : pingPongTextures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    atrousShader.use();
+    atrousShader.setInt("gPosition", POSITION_UNIT);
+    atrousShader.setInt("gNormal", NORMAL_UNIT);
+    atrousShader.setInt("gObjectID", OBJECT_ID_UNIT);
+    atrousShader.setInt("history", HISTORY_UNIT);
+}
+
+ShadowDenoiser::~ShadowDenoiser() {
+    glDeleteTextures(2, pingPongTextures);
+    glDeleteProgram(atrousShader.ID);
+}
+
+void ShadowDenoiser::denoise(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal, unsigned int gObjectID,
+    const glm::vec3& viewPos, const Noise& noise, const Parameters& parameters) {
+    if (parameters.iterations <= 0)
+        return;
+
+    atrousShader.use();
+    atrousShader.setVec3("viewPos", viewPos);
+    atrousShader.setFloat("normalPhi", parameters.normalPhi);
+    atrousShader.setFloat("planePhi", parameters.planePhi);
+    atrousShader.setFloat("visibilityPhi", parameters.visibilityPhi);
+    atrousShader.setInt("layer", static_cast<int>(layer));
+    atrousShader.setBool("hasHistory", noise.history != 0);
+    atrousShader.setFloat("samplesPerFrame", static_cast<float>(noise.samplesPerFrame));
+    atrousShader.setFloat("maxFrames", noise.maxFrames);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE0 + OBJECT_ID_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gObjectID);
+    glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, noise.history);
+
+    // The first pass reads the light's layer, the rest go back and forth between the two
+    // ping-pong textures, and the last result is copied back into the layer
+    for (int i{ 0 }; i < parameters.iterations; ++i) {
+        if (i == 0)
+            glBindImageTexture(0, shadowArray, 0, GL_FALSE, layer, GL_READ_ONLY, GL_R16F);
+        else
+            glBindImageTexture(0, pingPongTextures[(i - 1) % 2], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
+        glBindImageTexture(1, pingPongTextures[i % 2], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+
+        atrousShader.setInt("stepWidth", parameters.stepWidth << i);
+        atrousShader.dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glCopyImageSubData(pingPongTextures[(parameters.iterations - 1) % 2], GL_TEXTURE_2D, 0, 0, 0, 0,
+        shadowArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -0,0 +1,64 @@
+#ifndef SHADOW_DENOISER_H
+#define SHADOW_DENOISER_H
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+/*
+	Edge-aware spatial filter for the ray traced shadows, the a-trous wavelet filter from
+	"Edge-Avoiding A-Trous Wavelet Transform for fast Global Illumination Filtering"
+	(Dammertz et al. 2010), as used by SVGF. Every iteration is a 5x5 B3 spline blur whose
+	taps are spread further apart each time, so a few cheap passes cover a wide area.
+	Taps are weighted down when the G-buffer says they're on a different surface, which
+	keeps the blur from leaking across edges:
+
+		gNormal    ==> normals pointing elsewhere
+		gPosition  ==> taps off the plane of the center pixel
+		gObjectID  ==> taps on another object
+
+	and, like SVGF's luminance weight, when a tap's visibility differs from the center by more
+	than the noise explains. The noise follows from the number of rays behind a pixel, which
+	ShadowTemporalFilter's history knows, so converged shadows are hardly blurred at all.
+
+	It runs after ShadowTemporalFilter, on the accumulated shadows, and writes the result
+	back into the shadow array, so the history itself stays unfiltered.
+*/
+class ShadowDenoiser {
+public:
+	ShadowDenoiser(unsigned int width, unsigned int height);
+	~ShadowDenoiser();
+
+	ShadowDenoiser(const ShadowDenoiser&) = delete;
+	ShadowDenoiser& operator=(const ShadowDenoiser&) = delete;
+
+	struct Parameters {
+		int iterations;
+		int stepWidth; // distance between taps in the first iteration, doubled every iteration after
+		float normalPhi; // exponent on the normal similarity, higher is stricter
+		float planePhi; // plane distance, relative to the distance to the camera, where a tap's weight drops to 1 / e
+		float visibilityPhi; // difference from the center, in standard deviations of the noise, where a tap's weight drops to 1 / e
+	};
+
+	// How many shadow rays went into each pixel
+	struct Noise {
+		unsigned int history; // ShadowTemporalFilter::history(), or 0 without temporal accumulation
+		int samplesPerFrame;
+		float maxFrames; // ShadowTemporalFilter::effectiveFrames()
+	};
+
+	// Filters layer of shadowArray (R16F) in place. gObjectID is the R32UI target gbuffer.frag writes to location 3.
+	void denoise(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal, unsigned int gObjectID,
+		const glm::vec3& viewPos, const Noise& noise, const Parameters& parameters);
+
+private:
+	Shader atrousShader{ "shadow_atrous.comp" };
+
+	unsigned int width;
+	unsigned int height;
+
+	// R16F ping-pong targets, shared by every light since they are filtered one at a time
+	unsigned int pingPongTextures[2]{ 0, 0 };
+};
+
+#endif // !SHADOW_DENOISER_H
@@ -0,0 +1,87 @@
+#include <string>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "shadow_invalidation.h"
+
+namespace {
+    // Texture unit shadow_invalidate.comp samples the positions from
+    constexpr int POSITION_UNIT{ 0 };
+
+    // Indirect dispatch arguments and pixel count in front of the pixels, see TracedPixels in shadow_invalidate.comp
+    constexpr GLsizeiptr PIXEL_LIST_HEADER_SIZE{ 4 * sizeof(uint32_t) };
+
+    // Every tile takes this many entries, even the partial ones at the edge of the screen
+    constexpr GLsizeiptr TILE_PIXELS{ 16 * 16 };
+}
+
+ShadowInvalidation::ShadowInvalidation(unsigned int width, unsigned int height, unsigned int lights)
+    : width{ width }
+    , height{ height }
+{
+    glGenBuffers(1, &pixelListSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    const GLsizeiptr tiles{ static_cast<GLsizeiptr>((width + 16 - 1) / 16) * ((height + 16 - 1) / 16) };
+    glBufferData(GL_SHADER_STORAGE_BUFFER, PIXEL_LIST_HEADER_SIZE + tiles * TILE_PIXELS * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenTextures(1, &undenoisedShadows);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, undenoisedShadows);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16F, width, height, lights);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    invalidateShader.use();
+    invalidateShader.setInt("gPosition", POSITION_UNIT);
+
+    PLOGD << "Shadow invalidation: " << lights << " layers of " << width << "x" << height;
+}
+
+ShadowInvalidation::~ShadowInvalidation() {
+    glDeleteBuffers(1, &pixelListSSBO);
+    glDeleteTextures(1, &undenoisedShadows);
+    glDeleteProgram(invalidateShader.ID);
+}
+
+void ShadowInvalidation::markDirtyTiles(unsigned int gPosition, const glm::vec3& viewPos, const glm::vec3& lightPosition, float lightRadius,
+    std::span<const BVH::AABB> dirtyBoxes) {
+    // No groups, one per dimension after that, no pixels
+    const uint32_t header[4]{ 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (dirtyBoxes.empty())
+        return;
+
+    invalidateShader.use();
+    invalidateShader.setVec3("viewPos", viewPos);
+    invalidateShader.setVec3("lightPos", lightPosition);
+    invalidateShader.setFloat("lightRadius", lightRadius);
+    invalidateShader.setInt("boxCount", static_cast<int>(dirtyBoxes.size()));
+    for (size_t i{ 0 }; i < dirtyBoxes.size(); ++i) {
+        invalidateShader.setVec3("boxMin[" + std::to_string(i) + "]", dirtyBoxes[i].min);
+        invalidateShader.setVec3("boxMax[" + std::to_string(i) + "]", dirtyBoxes[i].max);
+    }
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, pixelListSSBO);
+
+    invalidateShader.dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16);
+
+    // The ray tracer reads the list, and the GPU the dispatch arguments in it
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void ShadowInvalidation::store(unsigned int shadowArray, unsigned int layer) {
+    glCopyImageSubData(shadowArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+        undenoisedShadows, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1);
+}
+
+void ShadowInvalidation::restore(unsigned int shadowArray, unsigned int layer) {
+    glCopyImageSubData(undenoisedShadows, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+        shadowArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1);
+}
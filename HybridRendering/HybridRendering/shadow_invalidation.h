@@ -0,0 +1,57 @@
+#ifndef SHADOW_INVALIDATION_H
+#define SHADOW_INVALIDATION_H
+
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "shader.h"
+
+/*
+	Re-traces only the parts of a light's shadow a moving object can have changed, see
+	ShadowCache. shadow_invalidate.comp looks at every pixel of the screen, in 16x16 tiles:
+
+		shadow ray from the pixel to the light's sphere crosses a dirty box  ==> its shadow changed
+		view ray from the camera to the pixel crosses a dirty box            ==> the surface itself changed
+
+	and appends every tile with any such pixel to a pixel list, in the format of TracedPixels
+	in ray_trace.comp, so the ray tracer only runs on those tiles. Each tile is a whole
+	256-entry group of the list, so adaptive sampling still finds a pixel's neighbours.
+
+	Everywhere else last frame's visibility is reused. The shadow array holds denoised
+	shadows by the end of a frame, which can't be filtered again, so every traced light's
+	layer is also kept here from before denoising, and put back before its tiles are traced.
+*/
+class ShadowInvalidation {
+public:
+	ShadowInvalidation(unsigned int width, unsigned int height, unsigned int lights);
+	~ShadowInvalidation();
+
+	ShadowInvalidation(const ShadowInvalidation&) = delete;
+	ShadowInvalidation& operator=(const ShadowInvalidation&) = delete;
+
+	// Lists the tiles of a light whose shadow one of dirtyBoxes can have changed
+	void markDirtyTiles(unsigned int gPosition, const glm::vec3& viewPos, const glm::vec3& lightPosition, float lightRadius,
+		std::span<const BVH::AABB> dirtyBoxes);
+
+	// SSBO with the indirect dispatch arguments, the pixel count and the pixels, see TracedPixels in shadow_invalidate.comp
+	unsigned int pixelList() const { return pixelListSSBO; }
+
+	// Keeps layer of shadowArray (R16F) before it's denoised, and puts it back
+	void store(unsigned int shadowArray, unsigned int layer);
+	void restore(unsigned int shadowArray, unsigned int layer);
+
+private:
+	Shader invalidateShader{ "shadow_invalidate.comp" };
+
+	unsigned int width;
+	unsigned int height;
+
+	unsigned int pixelListSSBO{ 0 };
+
+	// R16F array, a layer per light
+	unsigned int undenoisedShadows{ 0 };
+};
+
+#endif // !SHADOW_INVALIDATION_H
@@ -0,0 +1,101 @@
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "shadow_temporal_filter.h"
+
+namespace {
+    // Texture units shadow_temporal.comp samples from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+    constexpr int PREVIOUS_POSITION_UNIT{ 2 };
+    constexpr int PREVIOUS_NORMAL_UNIT{ 3 };
+    constexpr int HISTORY_UNIT{ 4 };
+
+    void setNearest(GLenum target) {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
+ShadowTemporalFilter::ShadowTemporalFilter(unsigned int width, unsigned int height, unsigned int layers)
+    : width{ width }
+    , height{ height }
+    , layers{ layers }
+{
+    glGenTextures(2, historyTextures);
+    for (unsigned int texture : historyTextures) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RG16F, width, height, layers);
+        setNearest(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    for (unsigned int* texture : { &previousPosition, &previousNormal }) {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_2D, *texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+        setNearest(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    temporalShader.use();
+    temporalShader.setInt("gPosition", POSITION_UNIT);
+    temporalShader.setInt("gNormal", NORMAL_UNIT);
+    temporalShader.setInt("previousPosition", PREVIOUS_POSITION_UNIT);
+    temporalShader.setInt("previousNormal", PREVIOUS_NORMAL_UNIT);
+    temporalShader.setInt("history", HISTORY_UNIT);
+
+    PLOGD << "Shadow history: " << layers << " layers of " << width << "x" << height;
+}
+
+ShadowTemporalFilter::~ShadowTemporalFilter() {
+    glDeleteTextures(2, historyTextures);
+    glDeleteTextures(1, &previousPosition);
+    glDeleteTextures(1, &previousNormal);
+    glDeleteProgram(temporalShader.ID);
+}
+
+void ShadowTemporalFilter::accumulate(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal, float minBlend) {
+    temporalShader.use();
+    temporalShader.setInt("layer", static_cast<int>(layer));
+    temporalShader.setMat4("previousViewProjection", previousViewProjection);
+    temporalShader.setBool("historyValid", historyValid);
+    temporalShader.setFloat("minBlend", minBlend);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE0 + PREVIOUS_POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, previousPosition);
+    glActiveTexture(GL_TEXTURE0 + PREVIOUS_NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, previousNormal);
+    glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, historyTextures[1 - current]);
+
+    glBindImageTexture(0, shadowArray, 0, GL_FALSE, layer, GL_READ_WRITE, GL_R16F);
+    glBindImageTexture(1, historyTextures[current], 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_RG16F);
+
+    temporalShader.dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void ShadowTemporalFilter::keep(unsigned int layer) {
+    glCopyImageSubData(historyTextures[1 - current], GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+        historyTextures[current], GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1);
+}
+
+void ShadowTemporalFilter::endFrame(const glm::mat4& viewProjection, unsigned int gPosition, unsigned int gNormal) {
+    glCopyImageSubData(gPosition, GL_TEXTURE_2D, 0, 0, 0, 0, previousPosition, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+    glCopyImageSubData(gNormal, GL_TEXTURE_2D, 0, 0, 0, 0, previousNormal, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+
+    previousViewProjection = viewProjection;
+    current = 1 - current;
+    historyValid = true;
+}
+
+void ShadowTemporalFilter::reset() {
+    historyValid = false;
+}
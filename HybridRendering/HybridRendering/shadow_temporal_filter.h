@@ -0,0 +1,70 @@
+#ifndef SHADOW_TEMPORAL_FILTER_H
+#define SHADOW_TEMPORAL_FILTER_H
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+/*
+	Accumulates the ray traced shadows over time, so that a couple of rays per pixel and
+	frame add up to many. Every light keeps a history layer with the accumulated visibility
+	and how many frames went into it. Each frame, shadow_temporal.comp reprojects a pixel's
+	world position into the last frame, and blends the new samples into whatever history
+	is there, as long as the G-buffer says it is still the same surface.
+
+	The result replaces the new samples in the shadow array, so the lighting pass doesn't
+	have to know about any of this. The history is ping-ponged between two texture arrays,
+	and last frame's positions and normals are kept in copies of the G-buffer textures.
+*/
+class ShadowTemporalFilter {
+public:
+	// gPosition and gNormal are expected to be RGBA16F, like the G-buffer in main.cpp
+	ShadowTemporalFilter(unsigned int width, unsigned int height, unsigned int layers);
+	~ShadowTemporalFilter();
+
+	ShadowTemporalFilter(const ShadowTemporalFilter&) = delete;
+	ShadowTemporalFilter& operator=(const ShadowTemporalFilter&) = delete;
+
+	/*
+		Blends this frame's samples in layer of shadowArray (R16F) into that light's history
+		and writes the result back. minBlend is the smallest weight the new samples get, so
+		1 / minBlend is roughly how many frames the history can remember.
+	*/
+	void accumulate(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal, float minBlend);
+
+	// Carries layer's history over to this frame as it is, for a light that wasn't traced
+	void keep(unsigned int layer);
+
+	// Keeps this frame's camera and G-buffer for the next frame's reprojection. Call once after all lights.
+	void endFrame(const glm::mat4& viewProjection, unsigned int gPosition, unsigned int gNormal);
+
+	// Forgets the history, e.g. when accumulation is turned off or the samples change completely
+	void reset();
+
+	// The history written this frame, valid after endFrame. The G channel is the frame count.
+	unsigned int history() const { return historyTextures[1 - current]; }
+
+	// Once the blend weight bottoms out at minBlend the history stops getting less noisy. The
+	// exponential average then has the variance of a plain average over this many frames.
+	static float effectiveFrames(float minBlend) { return (2.0f - minBlend) / minBlend; }
+
+private:
+	Shader temporalShader{ "shadow_temporal.comp" };
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int layers;
+
+	// RG16F arrays, accumulated visibility and frame count. Written into historyTextures[current].
+	unsigned int historyTextures[2]{ 0, 0 };
+	unsigned int current{ 0 };
+
+	unsigned int previousPosition{ 0 };
+	unsigned int previousNormal{ 0 };
+	glm::mat4 previousViewProjection{ 1.0f };
+
+	// False until a whole frame has been accumulated
+	bool historyValid{ false };
+};
+
+#endif // !SHADOW_TEMPORAL_FILTER_H
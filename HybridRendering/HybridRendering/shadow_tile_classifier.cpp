@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <plog/Log.h>
+
+#include "shadow_tile_classifier.h"
+
+namespace {
+    // Texture units shadow_tile_classify.comp samples from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+    constexpr int OBJECT_ID_UNIT{ 2 };
+
+    constexpr unsigned int OCCLUDER_BINDING{ 18 };
+
+    // Indirect dispatch arguments and pixel count in front of the pixels, see TracedPixels in shadow_tile_classify.comp
+    constexpr GLsizeiptr PIXEL_LIST_HEADER_SIZE{ 4 * sizeof(uint32_t) };
+
+    // Every tile takes this many entries, even the partial ones at the edges of the rectangle
+    constexpr GLsizeiptr TILE_PIXELS{ 16 * 16 };
+}
+
+ShadowTileClassifier::ShadowTileClassifier(unsigned int width, unsigned int height) {
+    // Room for every tile of the screen
+    const GLsizeiptr tiles{ static_cast<GLsizeiptr>((width + 16 - 1) / 16) * ((height + 16 - 1) / 16) };
+    glGenBuffers(1, &pixelListSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, PIXEL_LIST_HEADER_SIZE + tiles * TILE_PIXELS * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &occluderSSBO);
+
+    classifyShader.use();
+    classifyShader.setInt("gPosition", POSITION_UNIT);
+    classifyShader.setInt("gNormal", NORMAL_UNIT);
+    classifyShader.setInt("gObjectID", OBJECT_ID_UNIT);
+
+    PLOGD << "Shadow tile classifier: " << (width + 16 - 1) / 16 << "x" << (height + 16 - 1) / 16 << " tiles";
+}
+
+ShadowTileClassifier::~ShadowTileClassifier() {
+    glDeleteBuffers(1, &pixelListSSBO);
+    glDeleteBuffers(1, &occluderSSBO);
+    glDeleteProgram(classifyShader.ID);
+}
+
+void ShadowTileClassifier::classify(unsigned int shadowArray, unsigned int rayCountArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+    unsigned int gObjectID, const glm::vec3& lightPosition, float lightRadius, float maxDistance, std::span<const Occluder> occluders,
+    const Utility::ScreenRect& rect) {
+    // No groups, one per dimension after that, no pixels
+    const uint32_t header[4]{ 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (rect.empty())
+        return;
+
+    // A zero sized buffer can't be bound, so there's always room for one
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, occluderSSBO);
+    if (occluders.size() > occluderCapacity || occluderCapacity == 0) {
+        occluderCapacity = std::max<size_t>(occluders.size(), 1);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, occluderCapacity * sizeof(Occluder), nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (!occluders.empty())
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, occluders.size_bytes(), occluders.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    classifyShader.use();
+    classifyShader.setVec3("lightPos", lightPosition);
+    classifyShader.setFloat("lightRadius", lightRadius);
+    classifyShader.setFloat("maxDistance", maxDistance);
+    classifyShader.setInt("occluderCount", static_cast<int>(occluders.size()));
+    classifyShader.setIVec2("rectMin", rect.min);
+    classifyShader.setIVec2("rectMax", rect.max);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glActiveTexture(GL_TEXTURE0 + OBJECT_ID_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gObjectID);
+
+    glBindImageTexture(0, shadowArray, 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_R16F);
+    glBindImageTexture(1, rayCountArray, 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_R8);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, pixelListSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUDER_BINDING, occluderSSBO);
+
+    const glm::ivec2 size{ rect.size() };
+    classifyShader.dispatch((size.x + 16 - 1) / 16, (size.y + 16 - 1) / 16);
+
+    // The ray tracer reads the list, and the GPU the dispatch arguments in it
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+uint32_t ShadowTileClassifier::readPixelCount() const {
+    uint32_t count{ 0 };
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelListSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(uint32_t), sizeof(count), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
@@ -0,0 +1,79 @@
+#ifndef SHADOW_TILE_CLASSIFIER_H
+#define SHADOW_TILE_CLASSIFIER_H
+
+#include <cstdint>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "utility.h"
+
+/*
+	Settles whole tiles of a light's shadow before any ray is traced. shadow_tile_classify.comp
+	runs one workgroup per 16x16 tile and bounds everything the tile's shadow rays can pass
+	through: the box around the tile's pixels, swept towards the box around the light sphere.
+	That volume is then tested against the world space bounds of every occluder:
+
+		no occluder touches the volume                    ==> lit
+		every pixel faces away from the whole light, on
+		a closed occluder                                 ==> umbra, the surface shadows itself
+		anything else                                     ==> ambiguous
+
+	A tile that lies on a single convex occluder and faces the whole light sphere can't be
+	shadowed by that occluder, so its own bounds are left out of the test. That's what lets
+	an open floor be lit without rays everywhere but around the crates' shadows.
+
+	Lit and umbra tiles get their shadow right there. Ambiguous tiles are appended to a pixel
+	list in the format of TracedPixels in ray_trace.comp, so it only runs on those.
+*/
+class ShadowTileClassifier {
+public:
+	ShadowTileClassifier(unsigned int width, unsigned int height);
+	~ShadowTileClassifier();
+
+	ShadowTileClassifier(const ShadowTileClassifier&) = delete;
+	ShadowTileClassifier& operator=(const ShadowTileClassifier&) = delete;
+
+	// Set in Occluder::flags
+	static constexpr uint32_t CONVEX{ 1u << 0 }; // can't shadow a point of its own surface that faces the light
+	static constexpr uint32_t CLOSED{ 1u << 1 }; // a ray leaving its surface backwards always hits it again
+
+	// Something the shadow rays can hit, with its world space bounds and the object ID the G-buffer has for it.
+	// Each vec3 is followed by a uint to line up with the std430 layout in the shader.
+	struct Occluder {
+		glm::vec3 boundsMin;
+		uint32_t objectID;
+		glm::vec3 boundsMax;
+		uint32_t flags;
+	};
+
+	/*
+		Classifies the tiles in rect for one light. Lit and umbra tiles are written to layer of
+		shadowArray (R16F), and 0 rays to the same layer of rayCountArray (R8). The rest end up
+		in pixelList(), a whole 256-entry group per tile, for ray_trace.comp's tracePixelList
+		and pixelListTiles modes.
+	*/
+	void classify(unsigned int shadowArray, unsigned int rayCountArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+		unsigned int gObjectID, const glm::vec3& lightPosition, float lightRadius, float maxDistance, std::span<const Occluder> occluders,
+		const Utility::ScreenRect& rect);
+
+	// SSBO with the indirect dispatch arguments, the pixel count and the pixels, see TracedPixels in shadow_tile_classify.comp
+	unsigned int pixelList() const { return pixelListSSBO; }
+
+	// Number of pixels the last classify() left for the ray tracer. Waits for the GPU.
+	uint32_t readPixelCount() const;
+
+private:
+	Shader classifyShader{ "shadow_tile_classify.comp" };
+
+	unsigned int pixelListSSBO{ 0 };
+
+	// The occluders of the last classify(), resized as needed
+	unsigned int occluderSSBO{ 0 };
+	size_t occluderCapacity{ 0 };
+};
+
+static_assert(sizeof(ShadowTileClassifier::Occluder) == 32, "Occluder must match the std430 layout in shadow_tile_classify.comp");
+
+#endif // !SHADOW_TILE_CLASSIFIER_H
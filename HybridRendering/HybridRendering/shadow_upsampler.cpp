@@ -0,0 +1,99 @@
+#include <glad/glad.h>
+
+#include "shadow_upsampler.h"
+
+namespace {
+    // Texture units shadow_upsample.comp samples the G-buffer from
+    constexpr int POSITION_UNIT{ 0 };
+    constexpr int NORMAL_UNIT{ 1 };
+
+    // Where in a scale x scale block the index-th frame traces. Every pair of index bits picks
+    // a quadrant, the lowest pair the largest one, so that consecutive frames land far apart
+    // like the thresholds of an ordered dither.
+    glm::ivec2 blockOffset(unsigned int index, int scale) {
+        const glm::ivec2 QUADRANTS[4]{ { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+
+        glm::ivec2 offset{ 0 };
+        for (int size{ scale / 2 }; size > 0; size /= 2, index /= 4)
+            offset += QUADRANTS[index % 4] * size;
+        return offset;
+    }
+}
+
+ShadowUpsampler::ShadowUpsampler(unsigned int width, unsigned int height)
+    : width{ width }
+    , height{ height }
+{
+    glGenTextures(1, &sparse);
+    glBindTexture(GL_TEXTURE_2D, sparse);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    upsampleShader.use();
+    upsampleShader.setInt("gPosition", POSITION_UNIT);
+    upsampleShader.setInt("gNormal", NORMAL_UNIT);
+}
+
+ShadowUpsampler::~ShadowUpsampler() {
+    glDeleteTextures(1, &sparse);
+    glDeleteProgram(upsampleShader.ID);
+}
+
+ShadowUpsampler::Pattern ShadowUpsampler::pattern(Settings::ShadowResolution resolution, unsigned int frameIndex) {
+    switch (resolution) {
+    case Settings::ShadowResolution::half:
+        return Pattern{ 2, false, blockOffset(frameIndex % 4, 2) };
+    case Settings::ShadowResolution::quarter:
+        return Pattern{ 4, false, blockOffset(frameIndex % 16, 4) };
+    case Settings::ShadowResolution::checkerboard:
+        return Pattern{ 1, true, glm::ivec2{ static_cast<int>(frameIndex % 2), 0 } };
+    default:
+        return Pattern{ 1, false, glm::ivec2{ 0 } };
+    }
+}
+
+ShadowUpsampler::TraceDispatch ShadowUpsampler::traceDispatch(const Pattern& pattern, const Utility::ScreenRect& rect) {
+    // Invocation i traces pixel i * scale + offset, or 2 * i.x + parity on a checkerboard. The
+    // first one may land a pixel before the rectangle, which is harmless.
+    glm::ivec2 first{};
+    glm::ivec2 end{};
+    if (pattern.checkerboard) {
+        first = glm::ivec2{ rect.min.x / 2, rect.min.y };
+        end = glm::ivec2{ (rect.max.x + 1) / 2, rect.max.y };
+    }
+    else {
+        first = glm::max((rect.min - pattern.offset) / pattern.scale, glm::ivec2{ 0 });
+        end = (rect.max - pattern.offset + pattern.scale - 1) / pattern.scale;
+    }
+
+    const glm::ivec2 invocations{ glm::max(end - first, glm::ivec2{ 0 }) };
+    return TraceDispatch{ first, glm::uvec2{ (invocations + 16 - 1) / 16 } };
+}
+
+void ShadowUpsampler::upsample(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+    const glm::vec3& viewPos, const Pattern& pattern, const Utility::ScreenRect& rect) {
+    if (rect.empty())
+        return;
+
+    upsampleShader.use();
+    upsampleShader.setVec3("viewPos", viewPos);
+    upsampleShader.setInt("scale", pattern.scale);
+    upsampleShader.setBool("checkerboard", pattern.checkerboard);
+    upsampleShader.setIVec2("offset", pattern.offset);
+    upsampleShader.setIVec2("rectMin", rect.min);
+    upsampleShader.setIVec2("rectMax", rect.max);
+
+    glActiveTexture(GL_TEXTURE0 + POSITION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+
+    glBindImageTexture(0, sparse, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R16F);
+    glBindImageTexture(1, shadowArray, 0, GL_FALSE, layer, GL_WRITE_ONLY, GL_R16F);
+
+    const glm::ivec2 size{ rect.size() };
+    upsampleShader.dispatch((size.x + 16 - 1) / 16, (size.y + 16 - 1) / 16);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -0,0 +1,64 @@
+#ifndef SHADOW_UPSAMPLER_H
+#define SHADOW_UPSAMPLER_H
+
+#include <glm/glm.hpp>
+
+#include "settings.h"
+#include "shader.h"
+#include "utility.h"
+
+/*
+	Lets the ray tracer shoot rays for only some of the pixels, see Settings::ShadowResolution.
+	ray_trace.comp writes the pixels it traces into a full resolution scratch texture, and
+	shadow_upsample.comp fills in the rest with a joint bilateral upsample ("Joint Bilateral
+	Upsampling", Kopf et al. 2007): every missing pixel averages its nearest traced pixels,
+	weighted down when the G-buffer says they're on a different surface.
+
+		gNormal    ==> normals pointing elsewhere
+		gPosition  ==> taps off the plane of the pixel
+
+	Which pixel of each block gets traced moves every frame, so temporal accumulation fills
+	in the detail a single frame doesn't have.
+*/
+class ShadowUpsampler {
+public:
+	ShadowUpsampler(unsigned int width, unsigned int height);
+	~ShadowUpsampler();
+
+	ShadowUpsampler(const ShadowUpsampler&) = delete;
+	ShadowUpsampler& operator=(const ShadowUpsampler&) = delete;
+
+	// Which pixels ray_trace.comp traces, see tracedPixel() there
+	struct Pattern {
+		int scale; // 1 traces every pixel, 2 one in every 2x2 block, 4 one in every 4x4 block
+		bool checkerboard; // every other pixel of each row, scale is ignored
+		glm::ivec2 offset; // traced pixel within the block, or the checkerboard's parity in x
+	};
+
+	static Pattern pattern(Settings::ShadowResolution resolution, unsigned int frameIndex);
+
+	// Which invocations of ray_trace.comp, in 16x16 groups starting at firstInvocation, cover the traced pixels of a rectangle
+	struct TraceDispatch {
+		glm::ivec2 firstInvocation;
+		glm::uvec2 groups;
+	};
+
+	static TraceDispatch traceDispatch(const Pattern& pattern, const Utility::ScreenRect& rect);
+
+	// R16F target the ray tracer writes the traced pixels to, when the pattern isn't full resolution
+	unsigned int sparseTexture() const { return sparse; }
+
+	// Reconstructs the pixels of layer of shadowArray (R16F) inside rect from sparseTexture()
+	void upsample(unsigned int shadowArray, unsigned int layer, unsigned int gPosition, unsigned int gNormal,
+		const glm::vec3& viewPos, const Pattern& pattern, const Utility::ScreenRect& rect);
+
+private:
+	Shader upsampleShader{ "shadow_upsample.comp" };
+
+	unsigned int width;
+	unsigned int height;
+
+	unsigned int sparse{ 0 };
+};
+
+#endif // !SHADOW_UPSAMPLER_H
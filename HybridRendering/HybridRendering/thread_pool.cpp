@@ -0,0 +1,74 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    // The calling thread also does work, so we need one less worker
+    for (unsigned int i{ 1 }; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(size_t _count, const std::function<void(size_t begin, size_t end)>& _body) {
+    if (_count == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        body = &_body;
+        count = _count;
+
+        // A few chunks per thread so that uneven chunks even out
+        chunkSize = std::max<size_t>(1, _count / (size() * 4));
+        nextChunk = 0;
+
+        busyWorkers = static_cast<unsigned int>(workers.size());
+        ++generation;
+    }
+    wakeWorkers.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock{ mutex };
+    workersDone.wait(lock, [this] { return busyWorkers == 0; });
+    body = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t lastGeneration{ 0 };
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{ mutex };
+            wakeWorkers.wait(lock, [&] { return stopping || generation != lastGeneration; });
+            if (stopping)
+                return;
+
+            lastGeneration = generation;
+        }
+
+        runChunks();
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (--busyWorkers == 0)
+            workersDone.notify_one();
+    }
+}
+
+void ThreadPool::runChunks() {
+    while (true) {
+        const size_t begin{ nextChunk.fetch_add(1) * chunkSize };
+        if (begin >= count)
+            return;
+
+        (*body)(begin, std::min(begin + chunkSize, count));
+    }
+}
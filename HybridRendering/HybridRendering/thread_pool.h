@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	A fixed set of worker threads that split loops between them.
+
+	parallelFor() blocks until every chunk is done, and the calling thread helps out
+	while it waits. It is not reentrant, so don't call parallelFor() from inside a body.
+*/
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency()));
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Runs body(begin, end) over chunks of [0, count) on all threads
+	void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body);
+
+	// Number of threads that work on a parallelFor(), including the caller
+	unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+private:
+	void workerLoop();
+
+	void runChunks();
+
+	std::vector<std::thread> workers{};
+
+	std::mutex mutex{};
+	std::condition_variable wakeWorkers{};
+	std::condition_variable workersDone{};
+
+	// The current job, only written while holding the mutex and no worker is busy
+	const std::function<void(size_t, size_t)>* body{ nullptr };
+	size_t count{ 0 };
+	size_t chunkSize{ 1 };
+	std::atomic<size_t> nextChunk{ 0 };
+
+	unsigned int busyWorkers{ 0 };
+	uint64_t generation{ 0 };
+	bool stopping{ false };
+};
+
+#endif // !THREAD_POOL_H
@@ -1,6 +1,8 @@
 #ifndef TRIANGLE_GPU_H
 #define TRIANGLE_GPU_H
 
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
 // vec4 to match std430 layout
@@ -29,4 +31,117 @@ struct TriangleGPU {
     }
 };
 
+// The part of a triangle that the shadow ray test reads, with the two edges from v0 precomputed
+// so that intersectTriangle() doesn't have to. 48 bytes instead of the 80 of a full TriangleGPU.
+struct TriangleEdgesGPU {
+	glm::vec4 v0;
+	glm::vec4 edge1; // v1 - v0
+	glm::vec4 edge2; // v2 - v0
+
+    explicit TriangleEdgesGPU(const TriangleGPU& triangle)
+        : v0(triangle.v0)
+        , edge1(triangle.v1 - triangle.v0)
+        , edge2(triangle.v2 - triangle.v0)
+    {
+    }
+};
+
+// Everything else about a triangle, only needed once a ray has hit it.
+// Stored in a separate buffer with the same indexing as the TriangleEdgesGPU one.
+struct TriangleShadingGPU {
+	glm::vec4 normal;
+	uint32_t id;
+	uint32_t padding[3]; // pad to 16-byte multiple
+
+    explicit TriangleShadingGPU(const TriangleGPU& triangle)
+        : normal(triangle.normal)
+        , id(triangle.id)
+        , padding{ 0, 0, 0 }
+    {
+    }
+};
+
+// Largest coordinate of the 16-bit grid used by TriangleLayout::quantized
+inline constexpr uint32_t QUANTIZED_POSITION_MAX{ 65535 };
+
+/*
+	Moves a triangle onto the 16-bit grid, where grid = (position - origin) * scale. Every
+	vertex goes to its nearest grid point, on its own, so triangles that share a vertex still
+	share it afterwards and a closed mesh stays closed. The snapped triangle is only within
+	half a cell per axis of the real one though, and can miss parts of it. ray_trace.comp
+	makes up for that by widening its test of quantized triangles, see
+	intersectQuantizedTriangle(). bvh_build_nodes.comp snaps dynamic meshes the same way.
+*/
+inline TriangleGPU quantizeToGrid(const TriangleGPU& triangle, const glm::vec3& origin, const glm::vec3& scale) {
+	// floor(x + 0.5) instead of round(), GLSL's round() may go either way at .5
+	const auto snap = [&origin, &scale](const glm::vec4& vertex) {
+		const glm::vec3 grid{ glm::floor((glm::vec3{ vertex } - origin) * scale + 0.5f) };
+		return glm::vec4{ glm::clamp(grid, glm::vec3{ 0.0f }, glm::vec3{ static_cast<float>(QUANTIZED_POSITION_MAX) }), 1.0f };
+	};
+
+	return TriangleGPU{ snap(triangle.v0), snap(triangle.v1), snap(triangle.v2), triangle.normal, triangle.id };
+}
+
+// A triangle snapped to the 16-bit grid spanning its mesh's bounds, see AccelerationStructure
+// for how the grid is set up. Packed x0 y0 | z0 x1 | y1 z1 | x2 y2 | z2, low half first.
+// 20 bytes instead of the 48 of TriangleEdgesGPU.
+struct TriangleQuantizedGPU {
+	uint32_t words[5];
+
+    // Takes a triangle that quantizeToGrid() has already moved onto the grid
+    explicit TriangleQuantizedGPU(const TriangleGPU& gridTriangle) {
+        const auto q = [](float value) { return static_cast<uint32_t>(value); };
+        words[0] = q(gridTriangle.v0.x) | (q(gridTriangle.v0.y) << 16);
+        words[1] = q(gridTriangle.v0.z) | (q(gridTriangle.v1.x) << 16);
+        words[2] = q(gridTriangle.v1.y) | (q(gridTriangle.v1.z) << 16);
+        words[3] = q(gridTriangle.v2.x) | (q(gridTriangle.v2.y) << 16);
+        words[4] = q(gridTriangle.v2.z);
+    }
+
+    // First vertex in grid coordinates
+    glm::vec4 v0() const {
+        return glm::vec4{ static_cast<float>(words[0] & 0xFFFFu), static_cast<float>(words[0] >> 16), static_cast<float>(words[1] & 0xFFFFu), 1.0f };
+    }
+};
+
+/*
+	How the ray tracer stores the triangle vertices, picked once for a whole acceleration structure.
+	All of them share the TriangleShadingGPU buffer and the triangle indexing.
+*/
+enum class TriangleLayout {
+	edges, // 0, a TriangleEdgesGPU per triangle, fewest fetches per test
+	indexed, // 1, shared vec4 vertices plus three uint32 indices per triangle
+	quantized, // 2, a TriangleQuantizedGPU per triangle, least memory but slightly larger triangles
+	num_options, // 3
+};
+
+inline const char* triangleLayoutName(TriangleLayout layout) {
+	switch (layout) {
+	case TriangleLayout::edges:
+		return "edges";
+	case TriangleLayout::indexed:
+		return "indexed";
+	case TriangleLayout::quantized:
+		return "quantized";
+	default:
+		return "Unknown";
+	}
+}
+
+// What the shaders that read or write triangles have to be compiled with for a layout
+inline const char* triangleLayoutDefines(TriangleLayout layout) {
+	switch (layout) {
+	case TriangleLayout::indexed:
+		return "#define TRIANGLE_LAYOUT_INDEXED\n";
+	case TriangleLayout::quantized:
+		return "#define TRIANGLE_LAYOUT_QUANTIZED\n";
+	default:
+		return "";
+	}
+}
+
+static_assert(sizeof(TriangleEdgesGPU) == 48, "TriangleEdgesGPU must match the std430 layout in the shaders");
+static_assert(sizeof(TriangleShadingGPU) == 32, "TriangleShadingGPU must match the std430 layout in the shaders");
+static_assert(sizeof(TriangleQuantizedGPU) == 20, "TriangleQuantizedGPU must match the std430 layout in the shaders");
+
 #endif // !TRIANGLE_GPU_H
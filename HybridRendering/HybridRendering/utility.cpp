@@ -232,10 +232,11 @@ namespace Utility {
         glBindVertexArray(0);
     }
 
-    void setupImguiWindow(Settings::RenderSettings& renderSettings) {
+    void setupImguiWindow(Settings::RenderSettings& renderSettings, const Settings::RenderStats& renderStats) {
         ImGui::Begin("Render Settings");
 
         ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+        ImGui::Text("Ray Tracing: %.2f ms (%s BLAS, %s triangles)", renderStats.rayTraceMilliseconds, renderStats.blasLayout, renderStats.triangleLayout);
 
         static ImGuiComboFlags renderModeFlags = 0;
         renderModeFlags |= ImGuiComboFlags_PopupAlignLeft;
@@ -275,6 +276,8 @@ namespace Utility {
         const std::array<std::string, 5> deferredShadingRenderModes{
             "Default",
             "Shadows",
+            "Rays Per Pixel",
+            "Lights Per Tile",
         };
 
         const std::string deferredShadingRenderModePreview{ deferredShadingRenderModes[static_cast<int>(renderSettings.deferredShadingRenderMode)] };
@@ -293,6 +296,219 @@ namespace Utility {
             ImGui::EndCombo();
         }
 
+        /* ==============================================================================
+        Shadow Sampling
+        =============================================================================== */
+        const std::array<std::string, 4> shadowSamplers{
+            "Hash",
+            "R2",
+            "Sobol",
+            "Blue Noise",
+        };
+
+        const std::string shadowSamplerPreview{ shadowSamplers[static_cast<int>(renderSettings.shadowSampler)] };
+
+        if (ImGui::BeginCombo("Shadow Sampler", shadowSamplerPreview.c_str(), renderModeFlags)) {
+            for (int i{ 0 }; i < static_cast<int>(Settings::ShadowSampler::num_options); ++i) {
+                bool is_selected{ static_cast<int>(renderSettings.shadowSampler) == i };
+
+                if (ImGui::Selectable(shadowSamplers[i].c_str(), is_selected))
+                    renderSettings.shadowSampler = static_cast<Settings::ShadowSampler>(i);
+
+                if (static_cast<int>(renderSettings.shadowSampler) == i)
+                    ImGui::SetItemDefaultFocus();
+            }
+
+            ImGui::EndCombo();
+        }
+
+        ImGui::SliderInt("Shadow Samples", &renderSettings.shadowSamples, 1, 32);
+
+        const std::array<std::string, 3> lightSamplings{
+            "Sphere Surface",
+            "Cone",
+            "Compare Variance",
+        };
+
+        const std::string lightSamplingPreview{ lightSamplings[static_cast<int>(renderSettings.lightSampling)] };
+
+        if (ImGui::BeginCombo("Light Sampling", lightSamplingPreview.c_str(), renderModeFlags)) {
+            for (int i{ 0 }; i < static_cast<int>(Settings::LightSampling::num_options); ++i) {
+                bool is_selected{ static_cast<int>(renderSettings.lightSampling) == i };
+
+                if (ImGui::Selectable(lightSamplings[i].c_str(), is_selected))
+                    renderSettings.lightSampling = static_cast<Settings::LightSampling>(i);
+
+                if (static_cast<int>(renderSettings.lightSampling) == i)
+                    ImGui::SetItemDefaultFocus();
+            }
+
+            ImGui::EndCombo();
+        }
+
+        if (renderSettings.lightSampling == Settings::LightSampling::compare && renderStats.comparedPixels > 0) {
+            ImGui::Text("Penumbra Pixels: %u", renderStats.comparedPixels);
+            ImGui::Text("Variance, Sphere (left): %.5f", renderStats.sphereSamplingVariance);
+            ImGui::Text("Variance, Cone (right): %.5f", renderStats.coneSamplingVariance);
+        }
+
+        const std::array<std::string, 4> shadowResolutions{
+            "Full",
+            "Half",
+            "Quarter",
+            "Checkerboard",
+        };
+
+        for (unsigned int light{ 0 }; light < Constants::NR_LIGHTS; ++light) {
+            Settings::ShadowResolution& resolution{ renderSettings.shadowResolutions[light] };
+            const std::string label{ "Light " + std::to_string(light) + " Shadow Resolution" };
+
+            if (ImGui::BeginCombo(label.c_str(), shadowResolutions[static_cast<int>(resolution)].c_str(), renderModeFlags)) {
+                for (int i{ 0 }; i < static_cast<int>(Settings::ShadowResolution::num_options); ++i) {
+                    bool is_selected{ static_cast<int>(resolution) == i };
+
+                    if (ImGui::Selectable(shadowResolutions[i].c_str(), is_selected))
+                        resolution = static_cast<Settings::ShadowResolution>(i);
+
+                    if (static_cast<int>(resolution) == i)
+                        ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+            }
+        }
+        ImGui::Checkbox("Scissor Lights", &renderSettings.scissorLights);
+        ImGui::SameLine();
+        ImGui::Text("(%.0f%% of the screen traced)", 100.0f * renderStats.scissoredScreenFraction);
+        ImGui::Checkbox("Trace All Lights In One Dispatch", &renderSettings.batchLights);
+        ImGui::Checkbox("Reuse Static Shadows", &renderSettings.cacheShadows);
+        ImGui::SameLine();
+        ImGui::Text("(%u of %u lights traced)", renderStats.tracedShadowLights, Constants::NR_LIGHTS);
+        if (renderSettings.cacheShadows) {
+            ImGui::Checkbox("Only Trace Around Moving Objects", &renderSettings.invalidateDirtyRegions);
+            ImGui::SameLine();
+            ImGui::Text("(%u lights)", renderStats.regionTracedShadowLights);
+        }
+        ImGui::Checkbox("Reservoir Light Sampling", &renderSettings.reservoirLighting);
+        if (renderSettings.reservoirLighting) {
+            ImGui::SliderInt("Candidate Lights", &renderSettings.reservoirCandidates, 1, 32);
+            ImGui::Checkbox("Temporal Reuse", &renderSettings.reservoirTemporalReuse);
+            ImGui::SliderInt("Spatial Neighbours", &renderSettings.reservoirSpatialSamples, 0, 8);
+            ImGui::SliderFloat("Spatial Radius", &renderSettings.reservoirSpatialRadius, 1.0f, 50.0f);
+            ImGui::SliderInt("Shadow Rays", &renderSettings.reservoirShadowRays, 1, 2);
+        }
+        ImGui::Checkbox("Test Only Triangles Near Lights", &renderSettings.cullLightTriangles);
+        if (renderSettings.cullLightTriangles) {
+            ImGui::SameLine();
+            ImGui::Text("(%u triangles in %u objects, %u lights with too many)", renderStats.lightTriangles, renderStats.lightObjects,
+                renderStats.lightTriangleOverflows);
+        }
+        ImGui::Checkbox("Tiled Light Culling", &renderSettings.tiledLighting);
+        if (renderSettings.tiledLighting && renderSettings.collectTraversalStats) {
+            ImGui::SameLine();
+            ImGui::Text("(%u tiles with too many lights)", renderStats.lightTileOverflows);
+        }
+        ImGui::SliderInt("Fill Lights", &renderSettings.fillLights, 0, static_cast<int>(Constants::MAX_FILL_LIGHTS));
+        ImGui::Checkbox("Hybrid Shadows", &renderSettings.hybridShadows);
+        if (renderSettings.hybridShadows) {
+            ImGui::SliderFloat("Min Blocker Distance", &renderSettings.hybridMinBlockerDistance, 0.05f, 2.0f);
+            if (renderSettings.collectTraversalStats)
+                ImGui::Text("%.1f%% of the screen left to the ray tracer", 100.0f * renderStats.hybridTracedFraction);
+        }
+        else {
+            ImGui::Checkbox("Skip Settled Tiles", &renderSettings.classifyShadowTiles);
+            if (renderSettings.classifyShadowTiles && renderSettings.collectTraversalStats)
+                ImGui::Text("%.1f%% of the screen left to the ray tracer", 100.0f * renderStats.tileTracedFraction);
+        }
+        ImGui::Checkbox("Adaptive Sampling", &renderSettings.adaptiveSampling);
+        if (renderSettings.adaptiveSampling) {
+            ImGui::SliderInt("Initial Samples", &renderSettings.adaptiveInitialSamples, 1, 16);
+            ImGui::SliderFloat("Agreement Threshold", &renderSettings.adaptiveThreshold, 0.0f, 0.5f);
+        }
+        ImGui::Checkbox("Rotate Samples Every Frame", &renderSettings.rotateSamples);
+        ImGui::Checkbox("Temporal Accumulation", &renderSettings.temporalAccumulation);
+        if (renderSettings.temporalAccumulation)
+            ImGui::SliderFloat("Min History Blend", &renderSettings.temporalMinBlend, 0.01f, 1.0f);
+
+        /* ==============================================================================
+        Shadow Denoiser
+        =============================================================================== */
+        ImGui::Checkbox("Denoise Shadows", &renderSettings.denoiseShadows);
+        if (renderSettings.denoiseShadows) {
+            ImGui::SliderInt("Denoise Iterations", &renderSettings.denoiseIterations, 1, 5);
+            ImGui::SliderInt("Denoise Filter Size", &renderSettings.denoiseStepWidth, 1, 4);
+            ImGui::SliderFloat("Denoise Normal Phi", &renderSettings.denoiseNormalPhi, 1.0f, 128.0f);
+            ImGui::SliderFloat("Denoise Plane Phi", &renderSettings.denoisePlanePhi, 0.001f, 0.1f, "%.3f");
+            ImGui::SliderFloat("Denoise Visibility Phi", &renderSettings.denoiseVisibilityPhi, 0.5f, 16.0f);
+        }
+
+        /* ==============================================================================
+        Scene
+        =============================================================================== */
+        ImGui::Checkbox("Animate Objects", &renderSettings.animateObjects);
+        ImGui::Checkbox("Build Crate BLAS on GPU", &renderSettings.gpuBuildCrateBLAS);
+
+        /* ==============================================================================
+        Traversal statistics
+        =============================================================================== */
+        ImGui::Checkbox("Collect Traversal Stats", &renderSettings.collectTraversalStats);
+        if (renderSettings.collectTraversalStats && renderStats.shadowRays > 0) {
+            ImGui::Text("Shadow Rays: %u", renderStats.shadowRays);
+            ImGui::Text("Node Bytes per Ray: %.1f", static_cast<double>(renderStats.nodeBytesFetched) / renderStats.shadowRays);
+            ImGui::Text("Node MB per Frame: %.2f", static_cast<double>(renderStats.nodeBytesFetched) / (1024.0 * 1024.0));
+            ImGui::Text("Triangle Bytes per Ray: %.1f", static_cast<double>(renderStats.triangleBytesFetched) / renderStats.shadowRays);
+        }
+
         ImGui::End();
     }
-}
+
+    ScreenRect projectSphere(const glm::vec3& center, float radius, const glm::mat4& viewProjection, glm::ivec2 screenSize) {
+        glm::vec2 ndcMin{ 1.0f };
+        glm::vec2 ndcMax{ -1.0f };
+        int cornersBehind{ 0 };
+
+        for (int corner{ 0 }; corner < 8; ++corner) {
+            const glm::vec3 offset{ corner & 1 ? radius : -radius, corner & 2 ? radius : -radius, corner & 4 ? radius : -radius };
+            const glm::vec4 clip{ viewProjection * glm::vec4{ center + offset, 1.0f } };
+
+            // Points behind the camera project to the wrong side of the screen
+            if (clip.w <= 0.0f) {
+                ++cornersBehind;
+                continue;
+            }
+
+            const glm::vec2 ndc{ glm::vec2{ clip.x, clip.y } / clip.w };
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+
+        if (cornersBehind == 8)
+            return ScreenRect{ glm::ivec2{ 0 }, glm::ivec2{ 0 } };
+        if (cornersBehind > 0)
+            return ScreenRect{ glm::ivec2{ 0 }, screenSize };
+
+        const glm::vec2 pixelMin{ glm::floor((ndcMin * 0.5f + 0.5f) * glm::vec2{ screenSize }) };
+        const glm::vec2 pixelMax{ glm::ceil((ndcMax * 0.5f + 0.5f) * glm::vec2{ screenSize }) };
+        return ScreenRect{
+            glm::clamp(glm::ivec2{ pixelMin }, glm::ivec2{ 0 }, screenSize),
+            glm::clamp(glm::ivec2{ pixelMax }, glm::ivec2{ 0 }, screenSize),
+        };
+    }
+
+    std::vector<TriangleGPU> createTriangles(std::span<const float> vertices, uint32_t& nextID) {
+        std::vector<TriangleGPU> triangles{};
+
+        // Since each point has 8 elements and we want 3 points per triangle
+        for (size_t j{ 0 }; j + (8 * 3) <= vertices.size(); j += (8 * 3)) {
+            triangles.emplace_back(
+                glm::vec4{ vertices[j], vertices[j + 1], vertices[j + 2], 1.0f },
+                glm::vec4{ vertices[j + 8], vertices[j + 9], vertices[j + 10], 1.0f },
+                glm::vec4{ vertices[j + 16], vertices[j + 17], vertices[j + 18], 1.0f },
+                glm::normalize(glm::vec4{ vertices[j + 19], vertices[j + 20], vertices[j + 21], 0.0f }), // normal
+                nextID++
+            );
+        }
+
+        return triangles;
+    }
+}
\ No newline at end of file
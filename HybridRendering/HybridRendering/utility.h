@@ -1,11 +1,15 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <span>
 #include <string_view>
+#include <vector>
 
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 
 #include "settings.h"
+#include "triangle_gpu.h"
 
 namespace Utility {
 	GLFWwindow* initializeWindow();
@@ -22,7 +26,24 @@ namespace Utility {
 
 	void renderQuad();
 
-	void setupImguiWindow(Settings::RenderSettings& renderSettings);
+	void setupImguiWindow(Settings::RenderSettings& renderSettings, const Settings::RenderStats& renderStats);
+
+	// Pixels [min, max) of a screen rectangle
+	struct ScreenRect {
+		glm::ivec2 min;
+		glm::ivec2 max;
+
+		bool empty() const { return min.x >= max.x || min.y >= max.y; }
+		glm::ivec2 size() const { return glm::max(max - min, glm::ivec2{ 0 }); }
+	};
+
+	// Conservative screen rectangle a sphere covers, from the corners of its bounding box. Spheres
+	// that reach behind the camera get the whole screen, ones entirely behind it an empty rectangle.
+	ScreenRect projectSphere(const glm::vec3& center, float radius, const glm::mat4& viewProjection, glm::ivec2 screenSize);
+
+	// Turns interleaved position/normal/texcoord vertices into triangles for the ray tracer.
+	// Every triangle gets its own id, taken from (and advancing) nextID.
+	std::vector<TriangleGPU> createTriangles(std::span<const float> vertices, uint32_t& nextID);
 
     // Positions, normals, and texture coordinates of a single 3D cube
     constexpr std::array<float, 8 * 36> cubeVertices{
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "bvh.h"
+
+namespace BVH {
+    namespace {
+        constexpr uint32_t QUANTIZED_MAX{ 255 };
+
+        bool isLeaf(const BVHNodeGPU& node) {
+            return (node.primitiveInfo & COUNT_MASK) != 0;
+        }
+
+        // Cell size for a biased exponent, built directly from the float bits so it's exact
+        float cellSize(uint32_t exponent) {
+            return std::bit_cast<float>(exponent << 23);
+        }
+
+        // Smallest power of two cell size (as a biased exponent) so that 255 cells span extent
+        uint32_t gridExponent(float extent) {
+            if (!(extent > 0.0f))
+                return 1;
+
+            // extent / 255 = m * 2^exponent with m in [0.5, 1), so 2^exponent is always enough
+            int exponent{ 0 };
+            std::frexp(extent / static_cast<float>(QUANTIZED_MAX), &exponent);
+            return static_cast<uint32_t>(std::clamp(exponent + 127, 1, 254));
+        }
+
+        // The largest grid line at or below value. Rounding in (value - origin) / cell can be off
+        // by one, so we check against the exact decode that ray_trace.comp does.
+        uint32_t quantizeDown(float value, float origin, float cell) {
+            float q{ std::clamp(std::floor((value - origin) / cell), 0.0f, static_cast<float>(QUANTIZED_MAX)) };
+            while (q > 0.0f && origin + q * cell > value)
+                q -= 1.0f;
+            return static_cast<uint32_t>(q);
+        }
+
+        // The smallest grid line at or above value, QUANTIZED_MAX + 1 if the grid is too small
+        uint32_t quantizeUp(float value, float origin, float cell) {
+            float q{ std::clamp(std::ceil((value - origin) / cell), 0.0f, static_cast<float>(QUANTIZED_MAX + 1)) };
+            while (q <= static_cast<float>(QUANTIZED_MAX) && origin + q * cell < value)
+                q += 1.0f;
+            return static_cast<uint32_t>(q);
+        }
+
+        template <uint32_t WIDTH>
+        struct Collapser {
+            const std::vector<BVHNodeGPU>& nodes;
+            std::vector<WideBVHNodeGPU<WIDTH>> wideNodes;
+
+            uint32_t left(uint32_t index) const {
+                return nodes[index].primitiveInfo >> COUNT_BITS;
+            }
+
+            uint32_t right(uint32_t index) const {
+                return nodes[left(index)].skipIndex;
+            }
+
+            // Emits the wide node for the subtree at nodes[index] and returns its index.
+            // stackSize is set to the stack entries needed below (and including) it.
+            uint32_t emit(uint32_t index, uint32_t& stackSize) {
+                // Start with the two children and keep opening the largest interior one
+                std::vector<uint32_t> slots{};
+                if (isLeaf(nodes[index]))
+                    slots.push_back(index);
+                else
+                    slots.assign({ left(index), right(index) });
+
+                while (slots.size() < WIDTH) {
+                    int largest{ -1 };
+                    float largestArea{ -1.0f };
+                    for (int i{ 0 }; i < static_cast<int>(slots.size()); ++i) {
+                        const BVHNodeGPU& child{ nodes[slots[i]] };
+                        const float area{ nodeBounds(child).surfaceArea() };
+                        if (!isLeaf(child) && area > largestArea) {
+                            largest = i;
+                            largestArea = area;
+                        }
+                    }
+
+                    if (largest == -1)
+                        break;
+
+                    const uint32_t opened{ slots[largest] };
+                    slots[largest] = left(opened);
+                    slots.push_back(right(opened));
+                }
+
+                const uint32_t wideIndex{ static_cast<uint32_t>(wideNodes.size()) };
+                wideNodes.emplace_back();
+
+                // Children are emitted right after their parent, so wideNodes may grow in here
+                uint32_t references[WIDTH]{};
+                uint32_t interiorChildren{ 0 };
+                uint32_t deepestChild{ 0 };
+                for (uint32_t i{ 0 }; i < WIDTH; ++i) {
+                    if (i >= slots.size()) {
+                        references[i] = INVALID_INDEX;
+                        continue;
+                    }
+
+                    const BVHNodeGPU& child{ nodes[slots[i]] };
+                    if (isLeaf(child)) {
+                        references[i] = child.primitiveInfo;
+                        continue;
+                    }
+
+                    uint32_t childStackSize{ 0 };
+                    references[i] = emit(slots[i], childStackSize) << COUNT_BITS;
+                    deepestChild = std::max(deepestChild, childStackSize);
+                    ++interiorChildren;
+                }
+
+                // All interior children get pushed at once, then we continue in one of them
+                stackSize = interiorChildren == 0 ? 0 : std::max(interiorChildren, interiorChildren - 1 + deepestChild);
+
+                WideBVHNodeGPU<WIDTH>& wide{ wideNodes[wideIndex] };
+                std::copy(std::begin(references), std::end(references), std::begin(wide.children));
+                quantize(wide, slots);
+                return wideIndex;
+            }
+
+            void quantize(WideBVHNodeGPU<WIDTH>& wide, const std::vector<uint32_t>& slots) const {
+                AABB bounds{};
+                for (uint32_t slot : slots)
+                    bounds.grow(nodeBounds(nodes[slot]));
+
+                wide.origin = bounds.min;
+                wide.exponents = 0;
+                std::fill(std::begin(wide.quantizedMin), std::end(wide.quantizedMin), 0u);
+                std::fill(std::begin(wide.quantizedMax), std::end(wide.quantizedMax), 0u);
+
+                for (int axis{ 0 }; axis < 3; ++axis) {
+                    uint32_t exponent{ gridExponent(bounds.max[axis] - bounds.min[axis]) };
+
+                    // Float rounding can leave the grid a hair too small, in which case we double it
+                    bool fits{ false };
+                    while (!fits) {
+                        fits = true;
+                        for (uint32_t slot : slots)
+                            fits = fits && quantizeUp(nodes[slot].aabbMax[axis], wide.origin[axis], cellSize(exponent)) <= QUANTIZED_MAX;
+                        if (!fits)
+                            ++exponent;
+                    }
+                    wide.exponents |= exponent << (8 * axis);
+
+                    const float cell{ cellSize(exponent) };
+                    for (uint32_t i{ 0 }; i < slots.size(); ++i) {
+                        const BVHNodeGPU& child{ nodes[slots[i]] };
+                        const uint32_t word{ axis * (WIDTH / 4) + i / 4 };
+                        const uint32_t shift{ 8 * (i % 4) };
+                        wide.quantizedMin[word] |= quantizeDown(child.aabbMin[axis], wide.origin[axis], cell) << shift;
+                        wide.quantizedMax[word] |= quantizeUp(child.aabbMax[axis], wide.origin[axis], cell) << shift;
+                    }
+                }
+            }
+        };
+    }
+
+    template <uint32_t WIDTH>
+    std::vector<WideBVHNodeGPU<WIDTH>> collapse(const std::vector<BVHNodeGPU>& nodes, uint32_t& stackSize) {
+        Collapser<WIDTH> collapser{ nodes, {} };
+        stackSize = 0;
+
+        if (!nodes.empty()) {
+            collapser.emit(0, stackSize);
+
+            // The root itself takes up an entry before anything else is pushed
+            stackSize = std::max(stackSize, 1u);
+        }
+
+        return std::move(collapser.wideNodes);
+    }
+
+    template std::vector<WideBVHNodeGPU<4>> collapse<4>(const std::vector<BVHNodeGPU>& nodes, uint32_t& stackSize);
+    template std::vector<WideBVHNodeGPU<8>> collapse<8>(const std::vector<BVHNodeGPU>& nodes, uint32_t& stackSize);
+}
@@ -0,0 +1,32 @@
+#ifndef WIDE_BVH_NODE_GPU_H
+#define WIDE_BVH_NODE_GPU_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// A node of a wide BVH with WIDTH (4 or 8) children, whose boxes are stored as 8-bit
+// offsets on a grid spanning the node. The grid starts at origin and its cell size on each
+// axis is a power of two, stored as a biased float exponent in one byte of exponents.
+// Decoding a child box is then exact: origin + quantized * 2^(exponent - 127).
+//
+// Every child is referenced like BVHNodeGPU::primitiveInfo: (index << 3) | count, where a
+// count of 0 means index is another wide node. Unused slots hold 0xFFFFFFFF.
+//
+// The quantized bounds are packed 4 children per uint, first all x, then y, then z.
+// alignas(16) pads the struct to the std430 array stride (64 bytes for BVH4, 96 for BVH8).
+template <uint32_t WIDTH>
+struct alignas(16) WideBVHNodeGPU {
+	static_assert(WIDTH == 4 || WIDTH == 8, "Wide BVH nodes have either 4 or 8 children");
+
+	glm::vec3 origin;
+	uint32_t exponents;
+	uint32_t children[WIDTH];
+	uint32_t quantizedMin[3 * WIDTH / 4];
+	uint32_t quantizedMax[3 * WIDTH / 4];
+};
+
+static_assert(sizeof(WideBVHNodeGPU<4>) == 64, "WideBVHNodeGPU<4> must match the std430 layout in the shaders");
+static_assert(sizeof(WideBVHNodeGPU<8>) == 96, "WideBVHNodeGPU<8> must match the std430 layout in the shaders");
+
+#endif // !WIDE_BVH_NODE_GPU_H